@@ -0,0 +1,221 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <util/delay.h>
+#include "config.h"
+#include "spi.h"
+#include "at89.h"
+
+#ifdef ENABLE_AT89
+
+#define AT89_READ_BYTE      0x20
+#define AT89_WRITE_BYTE     0x40
+#define AT89_READ_PAGE      0x30
+#define AT89_WRITE_PAGE     0x50
+
+static struct {
+    enum {
+        STREAM_NONE = 0,
+        STREAM_READ,
+        STREAM_WRITE,
+    } stream;
+    uint16_t next;          /* next address of the page being streamed */
+    uint16_t pagesize;
+    uint16_t poll_address;  /* last byte written which is not 0xff */
+    uint8_t poll_data;
+    bool poll_valid;
+} at89;
+
+#define PAGE_MASK (at89.pagesize - 1)
+
+void at89_init(uint16_t pagesize)
+{
+    at89.pagesize = pagesize;
+}
+
+static bool at89_attach(uint8_t freq)
+{
+    /* forget a page started before */
+    at89.stream = STREAM_NONE;
+    at89.poll_valid = false;
+
+    return spi_attach(freq);
+}
+
+static void at89_page_command(uint8_t cmd, uint16_t address)
+{
+    spi_send(cmd);
+    spi_send(HI8(address));
+
+    /* AT89S51/52 have 256 byte pages and only send the high byte */
+    if (at89.pagesize < 256)
+        spi_send(LO8(address) & ~PAGE_MASK);
+
+    at89.next = address & ~PAGE_MASK;
+}
+
+static uint8_t at89_read_byte(uint16_t address)
+{
+    spi_send(AT89_READ_BYTE);
+    spi_send(HI8(address));
+    spi_send(LO8(address));
+    return spi_send(0);
+}
+
+/* wait for a page or byte write, read back the last byte which is not 0xff */
+static void at89_wait(void)
+{
+    if (!at89.poll_valid) {
+        _delay_loop_2(FLASH_PAGE_TIMEOUT);
+        return;
+    }
+
+    at89.poll_valid = false;
+    for (uint8_t i = 0; i < FLASH_PAGE_POLL_TRIES; i++) {
+        if (at89_read_byte(at89.poll_address) == at89.poll_data)
+            return;
+        _delay_loop_2(FLASH_PAGE_POLL_TIMEOUT);
+    }
+}
+
+static void at89_finish(void)
+{
+    if (at89.stream == STREAM_READ) {
+        while (at89.next & PAGE_MASK) {
+            spi_send(0);
+            at89.next++;
+        }
+    } else if (at89.stream == STREAM_WRITE) {
+        /* 0xff leaves the bytes erased */
+        while (at89.next & PAGE_MASK) {
+            spi_send(0xff);
+            at89.next++;
+        }
+        at89_wait();
+    }
+
+    at89.stream = STREAM_NONE;
+}
+
+static uint8_t at89_read(uint16_t address, bool eeprom)
+{
+    /* no eeprom access for at89 devices */
+    if (eeprom)
+        return 0xff;
+
+    if (at89.stream != STREAM_READ || address != at89.next) {
+        at89_finish();
+
+        at89_page_command(AT89_READ_PAGE, address);
+        at89.stream = STREAM_READ;
+
+        /* skip to address */
+        while (at89.next != address) {
+            spi_send(0);
+            at89.next++;
+        }
+    }
+
+    uint8_t data = spi_send(0);
+
+    /* the page ends the stream */
+    if ((++at89.next & PAGE_MASK) == 0)
+        at89.stream = STREAM_NONE;
+
+    return data;
+}
+
+static void at89_write(uint16_t address, uint8_t data, uint8_t memory)
+{
+    if (memory == ISP_MEMORY_EEPROM)
+        return;
+
+    bool poll = memory == ISP_MEMORY_FLASH;
+    if (poll) {
+        at89_finish();
+
+        spi_send(AT89_WRITE_BYTE);
+        spi_send(HI8(address));
+        spi_send(LO8(address));
+        spi_send(data);
+    } else {
+        /* continue the page if address is in it and not yet written */
+        if (at89.stream != STREAM_WRITE || address < at89.next
+                || (address & ~PAGE_MASK) != (at89.next & ~PAGE_MASK)) {
+            at89_finish();
+
+            at89_page_command(AT89_WRITE_PAGE, address);
+            at89.stream = STREAM_WRITE;
+        }
+
+        /* fill a gap */
+        while (at89.next != address) {
+            spi_send(0xff);
+            at89.next++;
+        }
+
+        spi_send(data);
+    }
+
+    if (data != 0xff) {
+        at89.poll_address = address;
+        at89.poll_data = data;
+        at89.poll_valid = true;
+    }
+
+    if (poll) {
+        at89_wait();
+        return;
+    }
+
+    /* the device starts programming after the last byte of the page */
+    if ((++at89.next & PAGE_MASK) == 0) {
+        at89_wait();
+        at89.stream = STREAM_NONE;
+    }
+}
+
+/* the device starts programming after the last byte of a page */
+static void at89_write_page(uint16_t address)
+{
+    (void)address;
+    at89_finish();
+}
+
+const struct isp_family_t at89_family = {
+    .reset_high = true,
+    .echo_index = 3,
+    .echo = 0x69,
+    .attach = at89_attach,
+    .read = at89_read,
+    .write = at89_write,
+    .write_page = at89_write_page,
+    .finish = at89_finish,
+};
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __AT89_H
+#define __AT89_H
+
+#include <stdint.h>
+#include "spi.h"
+
+/* AT89S51/52/8253 (8051) isp: reset is active high, flash is read and
+ * written in page mode, a page is sent after one command and address, so
+ * consecutive bytes are streamed until the end of the page */
+
+/* set the flash page size */
+void at89_init(uint16_t pagesize);
+
+/* selected by isp_set_family(ISP_FAMILY_AT89) */
+extern const struct isp_family_t at89_family;
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "config.h"
+#include "clock.h"
+
+#ifdef ENABLE_CLOCK_OUTPUT
+
+static const uint16_t prescalers[] = { 1, 8, 64, 256, 1024 };
+
+uint32_t clock_output(uint32_t freq)
+{
+    /* stop timer1 */
+    TCCR1B = 0;
+    TCCR1A = 0;
+
+    if (freq == 0) {
+        CLOCK_DDR &= ~_BV(CLOCK_PIN);
+        return 0;
+    }
+
+    /* the pin toggles on every compare match, use the smallest prescaler
+     * for which the compare value fits */
+    uint8_t i = 0;
+    uint32_t top;
+    do {
+        uint32_t div = F_CPU/2/prescalers[i];
+        top = (div + freq/2) / freq;
+        if (top == 0)
+            top = 1;
+        if (top <= 0x10000)
+            break;
+    } while (++i < sizeof(prescalers)/sizeof(prescalers[0]));
+
+    /* slower than possible, use the lowest frequency */
+    if (i == sizeof(prescalers)/sizeof(prescalers[0])) {
+        i--;
+        top = 0x10000;
+    }
+
+    OCR1A = top - 1;
+    TCNT1 = 0;
+    TCCR1A = _BV(COM1A0);
+    TCCR1B = _BV(WGM12) | (i + 1);
+    CLOCK_DDR |= _BV(CLOCK_PIN);
+
+    return F_CPU/2/prescalers[i]/top;
+}
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __CLOCK_H
+#define __CLOCK_H
+
+#include <stdint.h>
+
+/* clock output for the target on OC1A (timer1 in ctc mode toggling the pin),
+ * for devices fused for an external clock or running on a slow rc oscillator,
+ * enable it before entering programming mode */
+
+/* set the frequency (up to F_CPU/2) in Hz, 0 disables the output, returns
+ * the frequency actually generated */
+uint32_t clock_output(uint32_t freq);
+
+#endif
@@ -5,8 +5,85 @@
 /* uncomment this if you want a usb echo function (for communication testing) */
 //#define ENABLE_ECHO_FUNC
 
-/* uncomment this for debug information via uart */
+/* uncomment this for high speed flash programming via a loader stub in the
+ * boot section of the target (see stub.h) */
+//#define ENABLE_LOADER_STUB
+
+/* uncomment this for gang programming: MOSI, SCK and CS drive several devices
+ * in parallel, each device has its own MISO pin on GANG_PORTNAME */
+//#define ENABLE_GANG
+
+/* uncomment this for fixtures with several devices, each with its own reset
+ * line (SLOT_PINS), the other spi pins are shared and must be isolated by the
+ * fixture (e.g. buffers enabled by the reset line) */
+//#define ENABLE_MULTI_TARGET
+
+/* uncomment this for standalone programming of an image from an external spi
+ * flash or eeprom, started by a button (see standalone.h) */
+//#define ENABLE_STANDALONE
+/* program once on power-up too */
+//#define STANDALONE_AUTOSTART
+
+/* uncomment this for per-unit data (e.g. serial numbers) patched into the
+ * flash and eeprom data while programming (see patch.h) */
+//#define ENABLE_PATCH
+
+/* uncomment this for programming AT89S51/52/8253 (8051) devices, selected
+ * with a vendor request (see at89.h) */
+//#define ENABLE_AT89
+
+/* uncomment this for programming 25-series spi flash chips on the isp header,
+ * with CS instead of reset (see spiflash.h) */
+//#define ENABLE_SPIFLASH
+
+/* uncomment this for programming 24Cxx i2c eeproms on the isp header,
+ * selected with a vendor request (see i2c.h) */
+//#define ENABLE_I2C
+
+/* uncomment this for programming reduced core tinies via tpi (see tpi.h) */
+//#define ENABLE_TPI
+
+/* uncomment this for programming tinyAVR-0/1/2 and AVR-Dx devices via updi
+ * on the uart pins (see updi.h), cannot be used together with DEBUG_UART */
+//#define ENABLE_UPDI
+
+/* uncomment this for a usb to uart bridge to the target (see uart.h), cannot
+ * be used together with DEBUG_UART or ENABLE_UPDI */
+//#define ENABLE_UART_BRIDGE
+
+/* uncomment this for a clock output to the target (see clock.h), on kahuna
+ * it cannot be used together with ENABLE_STANDALONE */
+//#define ENABLE_CLOCK_OUTPUT
+
+/* uncomment this for a cycle profiler of the usb handlers and isp poll
+ * loops (see profile.h), uses timer1 and cannot be used together with
+ * ENABLE_CLOCK_OUTPUT */
+//#define ENABLE_PROFILE
+
+/* uncomment this for statistics of the gaps between usb_poll() calls (see
+ * pollstats.h), also warns if the timeouts below can exceed the 50ms limit */
+//#define ENABLE_POLL_STATS
+
+/* uncomment this for a sampling profiler of the whole firmware (see
+ * sampler.h and tools/sampler.py), uses timer0 */
+//#define ENABLE_SAMPLER
+
+/* uncomment this for the stack high-water mark and the free ram, readable
+ * via usb (see memory.h), "make ramuse" shows the static ram per module */
+//#define ENABLE_MEMORY_STATS
+
+/* uncomment this for counters of attaches, retries, bytes and poll timeouts
+ * readable via usb (see telemetry.h), and additionally to sum them up in
+ * eeprom after each session */
+//#define ENABLE_TELEMETRY
+//#define ENABLE_TELEMETRY_LIFETIME
+
+/* uncomment this to send the debug trace (make DEBUG=1, see debug.h) on the
+ * uart instead of reading it via usb */
 //#define DEBUG_UART
+#define DEBUG_BAUD      115200
+/* size of the trace buffer (power of two), 4 bytes each */
+#define DEBUG_EVENTS    32
 
 #ifdef HARDWARE_kahuna
     /* isp pins */
@@ -17,6 +94,27 @@
     #define SPI_SCK     PB5
     #define SPI_CS      PB0
 
+    /* gang programming miso pins */
+    #define GANG_PORTNAME   C
+    #define GANG_MASK       (_BV(PC2) | _BV(PC3) | _BV(PC4) | _BV(PC5))
+
+    /* multi target reset pins, selected by number */
+    #define SLOT_PORTNAME   C
+    #define SLOT_PINS       { PC2, PC3, PC4, PC5 }
+
+    /* image storage and start button for standalone programming */
+    #define STORAGE_PORTNAME    D
+    #define STORAGE_CS          PD5
+    #define STORAGE_SCK         PD6
+    #define STORAGE_MOSI        PD7
+    #define STORAGE_MISO        PD2
+    #define BUTTON_PORTNAME     B
+    #define BUTTON_PIN          PB1
+
+    /* clock output (OC1A) */
+    #define CLOCK_PORTNAME      B
+    #define CLOCK_PIN           PB1
+
     /* led pins */
     #define LED1_PORTNAME   C
     #define LED1_PIN        PC1
@@ -55,6 +153,40 @@
     #define USB_CFG_PULLUP_IOPORTNAME   B
     #define USB_CFG_PULLUP_BIT          0
 
+#elif defined(HARDWARE_host)
+    /* native build for testing (see host/), the pins are those of kahuna,
+     * the simulated target and storage are connected to them */
+    #define SPI_PORTNAME    B
+    #define SPI_SS      PB2
+    #define SPI_MOSI    PB3
+    #define SPI_MISO    PB4
+    #define SPI_SCK     PB5
+    #define SPI_CS      PB0
+
+    /* image storage and start button */
+    #define STORAGE_PORTNAME    D
+    #define STORAGE_CS          PD5
+    #define STORAGE_SCK         PD6
+    #define STORAGE_MOSI        PD7
+    #define STORAGE_MISO        PD2
+    #define BUTTON_PORTNAME     B
+    #define BUTTON_PIN          PB1
+
+    /* led pins */
+    #define LED1_PORTNAME   C
+    #define LED1_PIN        PC1
+    #define LED2_PORTNAME   C
+    #define LED2_PIN        PC0
+
+    /* usb, only used by usb_enable() and usb_disable() */
+    #define USB_CFG_IOPORTNAME      D
+    #define USB_CFG_DMINUS_BIT      4
+    #define USB_CFG_DPLUS_BIT       3
+    #define USB_INTR_CFG_SET        ((1 << ISC10) | (1 << ISC11))
+    #define USB_INTR_ENABLE_BIT     INT1
+    #define USB_INTR_PENDING_BIT    INTF1
+    #define USB_INTR_VECTOR         INT1_vect
+
 #else
     #error "unknown hardware platform!"
 #endif
@@ -63,17 +195,89 @@
 #define SPI_MAX_TRIES_HW    32
 #define SPI_MAX_TRIES_SW    8
 
-/* maximum eeprom and flash write timeouts (for _delay_loop_2) */
+/* usb disconnect before re-enumerating after a reset other than power-on,
+ * in loops of _delay_loop_2(0) (0x40000 cycles, rounded, 31 loops or
+ * 508ms at 16MHz) */
+#define USB_DISCONNECT_MS       500
+#define USB_DISCONNECT_LOOPS    ((F_CPU/1000*USB_DISCONNECT_MS + 0x20000) / 0x40000)
+
+/* maximum eeprom and flash write cycle times of the isp functions, the device
+ * is polled until then (see timer.h) */
+#define EEPROM_WRITE_TIMEOUT_MS 10
+#define FLASH_WRITE_TIMEOUT_MS  5           /* without page buffer */
+#define FLASH_PAGE_TIMEOUT_MS   10
+
+/* maximum write timeouts for at89 devices and fuses (for _delay_loop_2) */
 #define EEPROM_TIMEOUT  (F_CPU/100/4)       /* 10ms */
-#define EEPROM_POLL_TIMEOUT (F_CPU/10000/4) /* 100uS */
-#define EEPROM_POLL_TRIES   100             /* 100 times */
-#define FLASH_TIMEOUT   (F_CPU/200/4)       /* 5ms */
-#define FLASH_POLL_TIMEOUT  (F_CPU/10000/4) /* 100uS */
-#define FLASH_POLL_TRIES    50              /* 50 times */
 #define FLASH_PAGE_TIMEOUT   (F_CPU/100/4)       /* 10ms */
 #define FLASH_PAGE_POLL_TIMEOUT  (F_CPU/10000/4) /* 100uS */
 #define FLASH_PAGE_POLL_TRIES    100             /* 100 times */
 
+/* the write cycle time is measured during the first polled page and eeprom
+ * writes, writes which cannot be polled (0xff) use it instead of the timeouts above */
+#define ISP_TIMING_SAMPLES  4
+
+/* wait for the loader stub (in ms): to become ready for a
+ * command (page erase and write), for the device to start up (up to 65ms
+ * start-up time), for a checksum (64KiB need ~1.5s at 3MHz, the slowest
+ * clock usable with the stub) and for the erase of each of its pages when
+ * exiting */
+#define STUB_READY_TIMEOUT  20
+#define STUB_START_TIMEOUT  100
+#define STUB_CRC_TIMEOUT    2500
+#define STUB_ERASE_TIMEOUT  10
+/* bytes of the stub image written per status request, ~25ms at the lowest
+ * automatic sck */
+#define STUB_LOAD_BYTES     32
+
+/* tries with the remembered settings of a target slot before searching again */
+#define SLOT_TRIES  2
+
+/* image storage: 25-series spi flash (3 address bytes, 256 byte pages) or
+ * eeprom (e.g. 25LC512: 2 address bytes, 128 byte pages, and define
+ * STORAGE_EEPROM, most of these have no sector erase and overwrite bytes
+ * directly) */
+#define STORAGE_ADDRESS_BYTES   3
+#define STORAGE_PAGESIZE        256
+//#define STORAGE_EEPROM
+/* longest page program cycle of the storage in ms, the host polls while
+ * erasing */
+#define STORAGE_TIMEOUT         20
+/* largest flash page of a device programmed standalone */
+#define STANDALONE_MAX_PAGESIZE 128
+/* the atmega328p needs 10.5ms */
+#define CHIP_ERASE_TIMEOUT  (F_CPU/1000*11/4) /* 11ms */
+
+/* tpi: wait for the start bit of a response (default guard time is 128 bits)
+ * and for the nvm controller after a word write */
+#define TPI_START_TRIES 255             /* bits */
+#define TPI_BUSY_TRIES  200             /* status reads */
+
+/* spi flash: hardware spi prescaler (like SPR1:SPR0, 0 is F_CPU/4) and the
+ * longest page program cycle in ms, erases are polled by the host */
+#define SPIFLASH_PRESCALER  0
+#define SPIFLASH_TIMEOUT    20
+
+/* i2c: half bit time (for _delay_loop_2, ~100kHz) and ack polling after a
+ * page write (each try takes ~100us) */
+#define I2C_DELAY       (F_CPU/4/200000)
+#define I2C_POLL_TRIES  200
+
+/* updi baudrate and receive timeout (loop iterations, ~7ms) */
+#define UPDI_BAUD       115200
+#define UPDI_TIMEOUT    20000
+
+/* uart bridge buffer sizes (powers of two), 64 bytes last ~5.5ms at 115200 baud */
+#define UART_RX_BUFFER  64
+#define UART_TX_BUFFER  32
+
+/* number of patch table entries */
+#define PATCH_ENTRIES   4
+
+/* requests with their own profiler entry (usbasp ones by default), add
+ * those of interest, the others share one entry */
+#define PROFILE_REQUEST_LIST    { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 127 }
+
 #define DEFAULT_SPI_SW_DELAY    150 /* default delay for software spi, -> 26-33khz (16-20MHz) */
 
 /* more macros */
@@ -81,6 +285,62 @@
 #define SPI_DDR     _DDRPORT(SPI_PORTNAME)
 #define SPI_PIN     _INPORT(SPI_PORTNAME)
 
+#ifdef GANG_PORTNAME
+#define GANG_PORT   _OUTPORT(GANG_PORTNAME)
+#define GANG_DDR    _DDRPORT(GANG_PORTNAME)
+#define GANG_PIN    _INPORT(GANG_PORTNAME)
+#elif defined(ENABLE_GANG)
+#error "gang programming is not available for this hardware platform"
+#endif
+
+#ifdef SLOT_PORTNAME
+#define SLOT_PORT   _OUTPORT(SLOT_PORTNAME)
+#define SLOT_DDR    _DDRPORT(SLOT_PORTNAME)
+#elif defined(ENABLE_MULTI_TARGET)
+#error "multi target support is not available for this hardware platform"
+#endif
+
+#ifdef STORAGE_PORTNAME
+#define STORAGE_PORT    _OUTPORT(STORAGE_PORTNAME)
+#define STORAGE_DDR     _DDRPORT(STORAGE_PORTNAME)
+#define STORAGE_PIN     _INPORT(STORAGE_PORTNAME)
+#define BUTTON_PORT     _OUTPORT(BUTTON_PORTNAME)
+#define BUTTON_DDR      _DDRPORT(BUTTON_PORTNAME)
+#define BUTTON_INPUT    _INPORT(BUTTON_PORTNAME)
+#elif defined(ENABLE_STANDALONE)
+#error "standalone programming is not available for this hardware platform"
+#endif
+
+#ifdef CLOCK_PORTNAME
+#define CLOCK_DDR       _DDRPORT(CLOCK_PORTNAME)
+#elif defined(ENABLE_CLOCK_OUTPUT)
+#error "clock output is not available for this hardware platform"
+#endif
+
+#if defined(HARDWARE_kahuna) && defined(ENABLE_CLOCK_OUTPUT) && defined(ENABLE_STANDALONE)
+#error "clock output and the standalone button use the same pin"
+#endif
+
+#if defined(ENABLE_UPDI) && defined(DEBUG) && defined(DEBUG_UART)
+#error "updi and serial debug both use the uart"
+#endif
+
+#if defined(ENABLE_UART_BRIDGE) && ((defined(DEBUG) && defined(DEBUG_UART)) || defined(ENABLE_UPDI))
+#error "the uart bridge cannot be used together with serial debug or updi"
+#endif
+
+#if defined(ENABLE_TELEMETRY_LIFETIME) && !defined(ENABLE_TELEMETRY)
+#error "lifetime telemetry counters require ENABLE_TELEMETRY"
+#endif
+
+#if defined(ENABLE_PROFILE) && defined(ENABLE_CLOCK_OUTPUT)
+#error "the profiler and the clock output both use timer1"
+#endif
+
+#if defined(ENABLE_GANG) && defined(ENABLE_MULTI_TARGET)
+#error "gang programming and multi target support use the same pins"
+#endif
+
 #define LED1_DDR    _DDRPORT(LED1_PORTNAME)
 #define LED1_PORT   _OUTPORT(LED1_PORTNAME)
 #define LED2_DDR    _DDRPORT(LED2_PORTNAME)
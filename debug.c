@@ -25,18 +25,35 @@
 
 #include <stdint.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 
+#include "config.h"
 #include "debug.h"
+#include "timer.h"
 #include "platform.h"
 
 #ifdef DEBUG
 
-#warning "compiling with serial debug enabled"
+#warning "compiling with debug trace enabled"
+
+#if DEBUG_EVENTS & (DEBUG_EVENTS-1)
+#error "the number of debug events must be a power of two"
+#endif
+
+/* written by debug_event() only, read by the uart interrupt or debug_read() */
+static struct {
+    struct debug_event_t buf[DEBUG_EVENTS];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+} ring;
+
+static uint8_t lost;
 
 void debug_init(void)
 {
+#ifdef DEBUG_UART
      /* set baudrate */
-    #define BAUD 19200
+    #define BAUD DEBUG_BAUD
     #include <util/setbaud.h>
         UBRR0H = UBRRH_VALUE;
         UBRR0L = UBRRL_VALUE;
@@ -46,18 +63,89 @@ void debug_init(void)
         UCSR0A &= ~(1 << U2X0);
     #endif
 
-    UCSR0C = _BV(UCSZ00) | _BV(UCSZ01);
+    UCSR0C = UCSR0C_SELECT | _BV(UCSZ00) | _BV(UCSZ01);
     UCSR0B = _BV(TXEN0);
+#endif
+
+    debug_event(DEBUG_BOOT, 0);
+}
+
+static void debug_store(uint8_t event, uint8_t data)
+{
+    struct debug_event_t *e = &ring.buf[ring.head];
+
+    e->event = event;
+    e->data = data;
+    e->time = timer_timestamp();
+    ring.head = (ring.head + 1) & (DEBUG_EVENTS-1);
+}
+
+void debug_event(uint8_t event, uint8_t data)
+{
+    uint8_t free = (ring.tail - ring.head - 1) & (DEBUG_EVENTS-1);
+
+    /* keep a slot for the number of dropped events */
+    if (free < (lost ? 2 : 1)) {
+        if (lost < 0xff)
+            lost++;
+        return;
+    }
+
+    if (lost) {
+        debug_store(DEBUG_LOST, lost);
+        lost = 0;
+    }
+    debug_store(event, data);
 
-    debug_putc('b');
+#ifdef DEBUG_UART
+    /* UCSR0B is also changed by the interrupt handler */
+    uint8_t sreg = SREG;
+    cli();
+    UCSR0B |= _BV(UDRIE0);
+    SREG = sreg;
+#endif
 }
 
-void debug_putc(uint8_t data)
+#ifdef DEBUG_UART
+/* byte of the current event, each event is sent as 0xff and the structure */
+static uint8_t pos;
+
+/* called with the data register empty interrupt masked and interrupts enabled */
+void __vector_debug_udre(void) ISR_HANDLER;
+void __vector_debug_udre(void)
 {
-    while(!(UCSR0A & _BV(UDRE0)));
-    UDR0 = data;
+    if (ring.tail == ring.head)
+        return;
+
+    if (pos == 0)
+        UDR0 = 0xff;
+    else
+        UDR0 = ((uint8_t *)&ring.buf[ring.tail])[pos-1];
+
+    if (++pos > sizeof(struct debug_event_t)) {
+        pos = 0;
+        ring.tail = (ring.tail + 1) & (DEBUG_EVENTS-1);
+    }
+
+    cli();
+    UCSR0B |= _BV(UDRIE0);
 }
 
+UART_ISR(UART_UDRE_VECT, __vector_debug_udre, UDRIE0)
+#else
+uint8_t debug_read(uint8_t *buf, uint8_t len)
+{
+    uint8_t n = 0;
+
+    while (ring.tail != ring.head && (uint8_t)(len - n) >= sizeof(struct debug_event_t)) {
+        const uint8_t *e = (const uint8_t *)&ring.buf[ring.tail];
+        for (uint8_t i = 0; i < sizeof(struct debug_event_t); i++)
+            buf[n++] = e[i];
+        ring.tail = (ring.tail + 1) & (DEBUG_EVENTS-1);
+    }
 
+    return n;
+}
 #endif
 
+#endif
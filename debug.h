@@ -28,12 +28,54 @@
 
 #include <stdint.h>
 
+/* trace events with a timestamp (timer steps, see timer.h), stored in a ring
+ * buffer and sent on the uart in the background (DEBUG_UART) or read with
+ * FUNC_TRACE_READ, decoded by tools/trace.py, events are dropped while the
+ * buffer is full */
+
+struct debug_event_t {
+    uint8_t event;
+    uint8_t data;
+    uint16_t time;      /* little endian */
+};
+
+/* events (data) */
+#define DEBUG_BOOT              0x01
+#define DEBUG_LOST              0x02    /* number of events dropped before this one */
+#define DEBUG_CONNECT           0x03
+#define DEBUG_DISCONNECT        0x04
+#define DEBUG_READ              0x05    /* request */
+#define DEBUG_WRITE             0x06    /* request */
+#define DEBUG_ENABLEPROG        0x07
+#define DEBUG_ATTACH_AUTO       0x10
+#define DEBUG_ATTACH_HARDWARE   0x11
+#define DEBUG_ATTACH_SOFTWARE   0x12
+#define DEBUG_ATTACH_MANUAL     0x13    /* sck option */
+#define DEBUG_ATTACH_GANG       0x14
+#define DEBUG_ATTACH_SLOT       0x15    /* remembered settings of the target slot worked */
+#define DEBUG_ATTACHED          0x16
+#define DEBUG_PRESCALER         0x17    /* prescaler tried */
+#define DEBUG_PRESCALER_FAILED  0x18
+#define DEBUG_PRESCALER_FOUND   0x19    /* prescaler */
+#define DEBUG_STUB_START        0x20    /* prescaler */
+#define DEBUG_STUB_FINISH       0x21    /* sck option */
+#define DEBUG_TPI_CONNECT       0x28
+#define DEBUG_TPI_DISCONNECT    0x29
+#define DEBUG_TPI_TIMEOUT       0x2a
+#define DEBUG_TPI_FRAME_ERROR   0x2b
+#define DEBUG_STANDALONE_START  0x30
+#define DEBUG_STANDALONE_RESULT 0x31    /* result */
+
 #ifdef DEBUG
 void debug_init(void);
-void debug_putc(uint8_t data);
+void debug_event(uint8_t event, uint8_t data);
+#ifndef DEBUG_UART
+/* copies whole events to buf, returns the number of bytes */
+uint8_t debug_read(uint8_t *buf, uint8_t len);
+#endif
 #else
 #define debug_init()
-#define debug_putc(x)
+#define debug_event(event, data)
 #endif
 
 #endif
@@ -0,0 +1,93 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* avr/eeprom.h for the host build: variables declared EEMEM live in ordinary
+ * memory, which starts out erased like a new device.  a write starts a write
+ * cycle of HOST_EEPROM_WRITE_US, the next access waits for it like avr-libc
+ * does */
+
+#ifndef __HOST_AVR_EEPROM_H
+#define __HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define EEMEM   __attribute__((section("host_eeprom")))
+
+#define HOST_EEPROM_WRITE_US    8500
+
+/* in sim.c */
+bool host_eeprom_ready(void);
+void host_eeprom_wait(void);
+void host_eeprom_written(void);
+
+#define eeprom_is_ready host_eeprom_ready
+
+static inline void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    host_eeprom_wait();
+    memcpy(dst, src, n);
+}
+
+static inline uint8_t eeprom_read_byte(const uint8_t *p) { host_eeprom_wait(); return *p; }
+static inline uint16_t eeprom_read_word(const uint16_t *p) { host_eeprom_wait(); return *p; }
+static inline uint32_t eeprom_read_dword(const uint32_t *p) { host_eeprom_wait(); return *p; }
+
+static inline void eeprom_write_byte(uint8_t *p, uint8_t value)
+{
+    host_eeprom_wait();
+    *p = value;
+    host_eeprom_written();
+}
+
+static inline void eeprom_write_block(const void *src, void *dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        eeprom_write_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+}
+
+static inline void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+    if (eeprom_read_byte(p) != value)
+        eeprom_write_byte(p, value);
+}
+
+static inline void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        eeprom_update_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+}
+
+static inline void eeprom_write_word(uint16_t *p, uint16_t value) { eeprom_write_block(&value, p, 2); }
+static inline void eeprom_write_dword(uint32_t *p, uint32_t value) { eeprom_write_block(&value, p, 4); }
+static inline void eeprom_update_word(uint16_t *p, uint16_t value) { eeprom_update_block(&value, p, 2); }
+static inline void eeprom_update_dword(uint32_t *p, uint32_t value) { eeprom_update_block(&value, p, 4); }
+
+/* fill all EEMEM variables with 0xff */
+void host_eeprom_erase(void);
+
+#endif
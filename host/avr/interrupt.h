@@ -0,0 +1,54 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* avr/interrupt.h for the host build: interrupt service routines are plain
+ * functions, the simulation calls them while the I flag in SREG is set */
+
+#ifndef __HOST_AVR_INTERRUPT_H
+#define __HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define sei()   (SREG |= _BV(7))
+#define cli()   (SREG &= ~_BV(7))
+
+#define ISR(vector, ...)    void vector(void); void vector(void)
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define SIGNAL(vector)      ISR(vector)
+#define EMPTY_INTERRUPT(vector) ISR(vector) {}
+
+#define INT1_vect           host_vector_int1
+#define TIMER2_COMP_vect    host_vector_timer2_comp
+#define TIMER2_OVF_vect     host_vector_timer2_ovf
+#define TIMER1_COMPA_vect   host_vector_timer1_compa
+#define TIMER1_OVF_vect     host_vector_timer1_ovf
+#define TIMER0_OVF_vect     host_vector_timer0_ovf
+#define USART_RXC_vect      host_vector_usart_rxc
+#define USART_UDRE_vect     host_vector_usart_udre
+#define BADISR_vect         host_vector_bad
+
+#endif
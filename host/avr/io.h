@@ -0,0 +1,236 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* avr/io.h for the host build: the registers of an ATmega8, every access goes
+ * through host_reg() so that the simulation (see sim.c) sees it */
+
+#ifndef __HOST_AVR_IO_H
+#define __HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define __AVR_ATmega8__ 1
+
+enum {
+    HOST_PINB, HOST_DDRB, HOST_PORTB,
+    HOST_PINC, HOST_DDRC, HOST_PORTC,
+    HOST_PIND, HOST_DDRD, HOST_PORTD,
+    HOST_SPCR, HOST_SPSR, HOST_SPDR,
+    HOST_UBRRH, HOST_UBRRL, HOST_UCSRA, HOST_UCSRB, HOST_UCSRC, HOST_UDR,
+    HOST_TCCR0, HOST_TCNT0,
+    HOST_TCCR1A, HOST_TCCR1B, HOST_OCR1AH, HOST_OCR1AL, HOST_TCNT1H, HOST_TCNT1L,
+    HOST_TCCR2, HOST_TCNT2, HOST_OCR2, HOST_ASSR,
+    HOST_TIMSK, HOST_TIFR,
+    HOST_GICR, HOST_GIFR, HOST_MCUCR, HOST_MCUCSR,
+    HOST_SPMCR, HOST_WDTCR, HOST_SREG, HOST_SPL, HOST_SPH,
+    HOST_REGISTERS
+};
+
+enum {
+    HOST_OCR1A, HOST_TCNT1, HOST_ICR1,
+    HOST_REGISTERS16
+};
+
+volatile uint8_t *host_reg(uint8_t reg);
+volatile uint16_t *host_reg16(uint8_t reg);
+
+#define PINB    (*host_reg(HOST_PINB))
+#define DDRB    (*host_reg(HOST_DDRB))
+#define PORTB   (*host_reg(HOST_PORTB))
+#define PINC    (*host_reg(HOST_PINC))
+#define DDRC    (*host_reg(HOST_DDRC))
+#define PORTC   (*host_reg(HOST_PORTC))
+#define PIND    (*host_reg(HOST_PIND))
+#define DDRD    (*host_reg(HOST_DDRD))
+#define PORTD   (*host_reg(HOST_PORTD))
+#define SPCR    (*host_reg(HOST_SPCR))
+#define SPSR    (*host_reg(HOST_SPSR))
+#define SPDR    (*host_reg(HOST_SPDR))
+#define UBRRH   (*host_reg(HOST_UBRRH))
+#define UBRRL   (*host_reg(HOST_UBRRL))
+#define UCSRA   (*host_reg(HOST_UCSRA))
+#define UCSRB   (*host_reg(HOST_UCSRB))
+#define UCSRC   (*host_reg(HOST_UCSRC))
+#define UDR     (*host_reg(HOST_UDR))
+#define TCCR0   (*host_reg(HOST_TCCR0))
+#define TCNT0   (*host_reg(HOST_TCNT0))
+#define TCCR1A  (*host_reg(HOST_TCCR1A))
+#define TCCR1B  (*host_reg(HOST_TCCR1B))
+#define OCR1AH  (*host_reg(HOST_OCR1AH))
+#define OCR1AL  (*host_reg(HOST_OCR1AL))
+#define TCNT1H  (*host_reg(HOST_TCNT1H))
+#define TCNT1L  (*host_reg(HOST_TCNT1L))
+#define TCCR2   (*host_reg(HOST_TCCR2))
+#define TCNT2   (*host_reg(HOST_TCNT2))
+#define OCR2    (*host_reg(HOST_OCR2))
+#define ASSR    (*host_reg(HOST_ASSR))
+#define TIMSK   (*host_reg(HOST_TIMSK))
+#define TIFR    (*host_reg(HOST_TIFR))
+#define GICR    (*host_reg(HOST_GICR))
+#define GIFR    (*host_reg(HOST_GIFR))
+#define MCUCR   (*host_reg(HOST_MCUCR))
+#define MCUCSR  (*host_reg(HOST_MCUCSR))
+#define SPMCR   (*host_reg(HOST_SPMCR))
+#define WDTCR   (*host_reg(HOST_WDTCR))
+#define SREG    (*host_reg(HOST_SREG))
+#define SPL     (*host_reg(HOST_SPL))
+#define SPH     (*host_reg(HOST_SPH))
+
+#define OCR1A   (*host_reg16(HOST_OCR1A))
+#define TCNT1   (*host_reg16(HOST_TCNT1))
+#define ICR1    (*host_reg16(HOST_ICR1))
+
+/* memory layout */
+#define RAMEND      0x45f
+#define E2END       0x1ff
+#define FLASHEND    0x1fff
+#define SPM_PAGESIZE 64
+
+#define _BV(bit)    (1 << (bit))
+#define _SFR_IO_ADDR(reg)   0
+#define _SFR_MEM_ADDR(reg)  0
+#define __SREG__    0x3f
+#define __SP_L__    0x3d
+#define __SP_H__    0x3e
+
+/* port bits */
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+/* spi */
+#define SPIE    7
+#define SPE     6
+#define DORD    5
+#define MSTR    4
+#define CPOL    3
+#define CPHA    2
+#define SPR1    1
+#define SPR0    0
+#define SPIF    7
+#define WCOL    6
+#define SPI2X   0
+
+/* usart */
+#define RXC     7
+#define TXC     6
+#define UDRE    5
+#define FE      4
+#define DOR     3
+#define PE      2
+#define U2X     1
+#define MPCM    0
+#define RXCIE   7
+#define TXCIE   6
+#define UDRIE   5
+#define RXEN    4
+#define TXEN    3
+#define UCSZ2   2
+#define RXB8    1
+#define TXB8    0
+#define URSEL   7
+#define UMSEL   6
+#define UPM1    5
+#define UPM0    4
+#define USBS    3
+#define UCSZ1   2
+#define UCSZ0   1
+#define UCPOL   0
+
+/* timers */
+#define CS02    2
+#define CS01    1
+#define CS00    0
+#define COM1A1  7
+#define COM1A0  6
+#define COM1B1  5
+#define COM1B0  4
+#define WGM11   1
+#define WGM10   0
+#define ICNC1   7
+#define ICES1   6
+#define WGM13   4
+#define WGM12   3
+#define CS12    2
+#define CS11    1
+#define CS10    0
+#define FOC2    7
+#define WGM20   6
+#define COM21   5
+#define COM20   4
+#define WGM21   3
+#define CS22    2
+#define CS21    1
+#define CS20    0
+#define OCIE2   7
+#define TOIE2   6
+#define TICIE1  5
+#define OCIE1A  4
+#define OCIE1B  3
+#define TOIE1   2
+#define TOIE0   0
+#define OCF2    7
+#define TOV2    6
+#define ICF1    5
+#define OCF1A   4
+#define OCF1B   3
+#define TOV1    2
+#define TOV0    0
+
+/* external interrupts and reset flags */
+#define INT1    7
+#define INT0    6
+#define INTF1   7
+#define INTF0   6
+#define ISC11   3
+#define ISC10   2
+#define ISC01   1
+#define ISC00   0
+#define WDRF    3
+#define BORF    2
+#define EXTRF   1
+#define PORF    0
+
+#endif
@@ -0,0 +1,570 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "cpu.h"
+
+/* isp pins on port b, the same on all simulated devices */
+#define CPU_SCK     5
+#define CPU_MISO    4
+#define CPU_MOSI    3
+
+/* io addresses besides port b */
+#define CPU_SPMCSR  0x37
+#define CPU_SPL     0x3d
+#define CPU_SPH     0x3e
+
+/* SPMCSR bits */
+#define CPU_SPMEN   0x01
+#define CPU_PGERS   0x02
+#define CPU_PGWRT   0x04
+#define CPU_RWWSRE  0x10
+#define CPU_RWWSB   0x40
+
+/* SREG bits */
+#define SREG_C      0x01
+#define SREG_Z      0x02
+#define SREG_N      0x04
+#define SREG_V      0x08
+#define SREG_S      0x10
+#define SREG_H      0x20
+#define SREG_T      0x40
+
+/* start-up time after reset with the factory default fuses */
+#define CPU_STARTUP_US  65000
+
+static struct {
+    const struct target_device_t *device;
+    uint32_t clock;
+    bool running;
+
+    uint64_t start;         /* time of the first instruction (programmer cycles) */
+    uint64_t cycles;        /* target cycles since then */
+
+    uint32_t boot;          /* start of the boot section */
+    uint32_t nrww;          /* start of the no-read-while-write section */
+    uint16_t pc;            /* word address */
+    uint8_t r[32];
+    uint8_t sreg;
+    uint16_t sp;
+    uint8_t portb, ddrb;
+    uint8_t ram[TARGET_RAM_MAX];
+
+    /* self-programming: operation written to SPMCSR and the end of the four
+     * cycles in which spm executes it, rww busy until, halted until */
+    uint8_t spmcsr;
+    uint64_t spm_window;
+    bool rwwsb;
+    uint64_t busy_until;
+    uint64_t halt_until;
+    uint8_t buffer[256];
+} cpu;
+
+/* the programmer's hardware spi transfer on sck and mosi */
+static struct {
+    uint64_t start;
+    uint32_t half_period;
+    uint8_t data;
+} bus;
+
+static uint64_t cpu_us(uint32_t us)
+{
+    return (uint64_t)us * cpu.clock / 1000000;
+}
+
+/* time of the core in programmer cycles */
+static uint64_t cpu_now(void)
+{
+    return cpu.start + cpu.cycles * F_CPU / cpu.clock;
+}
+
+static void cpu_violation(void)
+{
+    target_stats.violations++;
+    cpu.running = false;
+}
+
+void cpu_start(const struct target_device_t *device, uint32_t clock, uint32_t pc)
+{
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.device = device;
+    cpu.clock = clock;
+    cpu.running = true;
+    cpu.start = sim_cycles + (uint64_t)CPU_STARTUP_US * (F_CPU/1000000);
+    cpu.boot = pc;
+    cpu.nrww = device->flash_size - 8 * device->boot_min;
+    cpu.pc = pc / 2;
+    memset(cpu.buffer, 0xff, sizeof(cpu.buffer));
+}
+
+bool cpu_running(void)
+{
+    return cpu.running;
+}
+
+/* sck and mosi, both low between transfers */
+static uint8_t cpu_pinb(void)
+{
+    uint8_t pin = cpu.portb & cpu.ddrb;
+    uint64_t now = cpu_now();
+
+    if (!(cpu.ddrb & _BV(CPU_MISO)))
+        pin |= _BV(CPU_MISO);
+
+    if (now >= bus.start && now < bus.start + 16 * (uint64_t)bus.half_period) {
+        uint32_t phase = (now - bus.start) / bus.half_period;
+        if (phase & 1)
+            pin |= _BV(CPU_SCK);
+        if ((bus.data << (phase / 2)) & 0x80)
+            pin |= _BV(CPU_MOSI);
+    }
+
+    return pin;
+}
+
+static uint8_t cpu_read_io(uint8_t address)
+{
+    const struct target_device_t *dev = cpu.device;
+
+    if (address == dev->pinb)
+        return cpu_pinb();
+    if (address == dev->pinb + 1)
+        return cpu.ddrb;
+    if (address == dev->pinb + 2)
+        return cpu.portb;
+
+    switch (address) {
+        case CPU_SPMCSR:
+            return (cpu.cycles < cpu.busy_until ? CPU_SPMEN : 0) | (cpu.rwwsb ? CPU_RWWSB : 0);
+        case CPU_SPL:
+            return cpu.sp;
+        case CPU_SPH:
+            return cpu.sp >> 8;
+    }
+
+    return 0;
+}
+
+static void cpu_write_io(uint8_t address, uint8_t data)
+{
+    const struct target_device_t *dev = cpu.device;
+
+    if (address == dev->pinb + 1)
+        cpu.ddrb = data;
+    else if (address == dev->pinb + 2)
+        cpu.portb = data;
+
+    switch (address) {
+        case CPU_SPMCSR:
+            cpu.spmcsr = data & 0x1f;
+            cpu.spm_window = cpu.cycles + 4;
+            break;
+        case CPU_SPL:
+            cpu.sp = (cpu.sp & 0xff00) | data;
+            break;
+        case CPU_SPH:
+            cpu.sp = (cpu.sp & 0x00ff) | data << 8;
+            break;
+    }
+}
+
+/* page erase and write take the time of a flash page write each, the core
+ * halts while the nrww section is written */
+static void cpu_spm(void)
+{
+    const struct target_device_t *dev = cpu.device;
+    uint16_t z = cpu.r[30] | cpu.r[31] << 8;
+    uint32_t page = (z & ~(dev->flash_pagesize - 1)) % dev->flash_size;
+    uint8_t op = cpu.spmcsr;
+
+    cpu.spmcsr = 0;
+    if (cpu.cycles > cpu.spm_window || !(op & CPU_SPMEN))
+        return;
+
+    if (cpu.cycles < cpu.busy_until) {
+        cpu_violation();
+        return;
+    }
+
+    switch (op) {
+        case CPU_SPMEN:
+            cpu.buffer[z & (dev->flash_pagesize - 2)] = cpu.r[0];
+            cpu.buffer[(z & (dev->flash_pagesize - 2)) + 1] = cpu.r[1];
+            return;
+        case CPU_PGERS | CPU_SPMEN:
+            memset(&target_flash[page], 0xff, dev->flash_pagesize);
+            break;
+        case CPU_PGWRT | CPU_SPMEN:
+            /* bits can only be cleared */
+            for (uint16_t i = 0; i < dev->flash_pagesize; i++)
+                target_flash[page + i] &= cpu.buffer[i];
+            memset(cpu.buffer, 0xff, sizeof(cpu.buffer));
+            target_stats.page_writes++;
+            break;
+        case CPU_RWWSRE | CPU_SPMEN:
+            cpu.rwwsb = false;
+            return;
+        default:
+            cpu_violation();
+            return;
+    }
+
+    if (page < cpu.nrww) {
+        cpu.rwwsb = true;
+        cpu.busy_until = cpu.cycles + cpu_us(dev->flash_write);
+    } else {
+        cpu.cycles += cpu_us(dev->flash_write);
+        cpu.halt_until = cpu.cycles;
+    }
+}
+
+static void cpu_push(uint8_t data)
+{
+    if (cpu.sp >= sizeof(cpu.ram)) {
+        cpu_violation();
+        return;
+    }
+    cpu.ram[cpu.sp--] = data;
+}
+
+static uint8_t cpu_pop(void)
+{
+    if (cpu.sp + 1 >= (int)sizeof(cpu.ram)) {
+        cpu_violation();
+        return 0;
+    }
+    return cpu.ram[++cpu.sp];
+}
+
+static uint16_t cpu_fetch(uint16_t pc)
+{
+    uint32_t address = (uint32_t)pc * 2 % cpu.device->flash_size;
+    return target_flash[address] | target_flash[address + 1] << 8;
+}
+
+/* lds, sts, jmp and call are skipped as two words */
+static bool cpu_two_words(uint16_t op)
+{
+    return (op & 0xfe0e) == 0x940c || (op & 0xfe0e) == 0x940e
+        || (op & 0xfe0f) == 0x9000 || (op & 0xfe0f) == 0x9200;
+}
+
+static void cpu_skip(void)
+{
+    uint8_t words = cpu_two_words(cpu_fetch(cpu.pc)) ? 2 : 1;
+
+    cpu.pc += words;
+    cpu.cycles += words;
+}
+
+static void cpu_flags(uint8_t mask, uint8_t flags)
+{
+    if (((flags & SREG_N) != 0) != ((flags & SREG_V) != 0))
+        flags |= SREG_S;
+    cpu.sreg = (cpu.sreg & ~mask) | (flags & mask);
+}
+
+/* subtraction with carry in, Z is only kept by cpc and sbci */
+static uint8_t cpu_sub(uint8_t d, uint8_t r, uint8_t carry, bool keep_z)
+{
+    uint8_t res = d - r - carry;
+    uint8_t borrow = (~d & r) | (r & res) | (res & ~d);
+    uint8_t flags = 0;
+
+    if (borrow & 0x80)
+        flags |= SREG_C;
+    if (borrow & 0x08)
+        flags |= SREG_H;
+    if (((d & ~r & ~res) | (~d & r & res)) & 0x80)
+        flags |= SREG_V;
+    if (res & 0x80)
+        flags |= SREG_N;
+    if (res == 0 && (!keep_z || (cpu.sreg & SREG_Z)))
+        flags |= SREG_Z;
+
+    cpu_flags(SREG_C | SREG_Z | SREG_N | SREG_V | SREG_S | SREG_H, flags);
+    return res;
+}
+
+static void cpu_logic(uint8_t res)
+{
+    cpu_flags(SREG_Z | SREG_N | SREG_V | SREG_S,
+            (res == 0 ? SREG_Z : 0) | (res & 0x80 ? SREG_N : 0));
+}
+
+/* lsr and ror */
+static uint8_t cpu_shift(uint8_t d, uint8_t msb)
+{
+    uint8_t res = msb | d >> 1;
+    uint8_t flags = (d & 1 ? SREG_C : 0) | (res == 0 ? SREG_Z : 0) | (res & 0x80 ? SREG_N : 0);
+
+    if (((flags & SREG_N) != 0) != ((flags & SREG_C) != 0))
+        flags |= SREG_V;
+    cpu_flags(SREG_C | SREG_Z | SREG_N | SREG_V | SREG_S, flags);
+    return res;
+}
+
+static void cpu_step(void)
+{
+    uint16_t op = cpu_fetch(cpu.pc);
+    uint8_t d = (op >> 4) & 0x1f;
+    uint8_t r = (op & 0x0f) | ((op >> 5) & 0x10);
+    uint8_t dh = 16 + ((op >> 4) & 0x0f);
+    uint8_t k = (op & 0x0f) | ((op >> 4) & 0xf0);
+    uint8_t io = (op >> 3) & 0x1f;
+    uint8_t bit = op & 7;
+
+    cpu.pc++;
+    cpu.cycles++;
+
+    if (op == 0xffff) {
+        /* erased flash */
+    } else if ((op & 0xf000) == 0xc000) {
+        /* rjmp */
+        cpu.pc += (int16_t)(op << 4) >> 4;
+        cpu.cycles++;
+    } else if ((op & 0xf000) == 0xd000) {
+        /* rcall */
+        cpu_push(cpu.pc);
+        cpu_push(cpu.pc >> 8);
+        cpu.pc += (int16_t)(op << 4) >> 4;
+        cpu.cycles += 2;
+    } else if (op == 0x9508) {
+        /* ret */
+        cpu.pc = cpu_pop() << 8;
+        cpu.pc |= cpu_pop();
+        cpu.cycles += 3;
+    } else if ((op & 0xf000) == 0xe000) {
+        /* ldi */
+        cpu.r[dh] = k;
+    } else if ((op & 0xf000) == 0x3000) {
+        /* cpi */
+        cpu_sub(cpu.r[dh], k, 0, false);
+    } else if ((op & 0xf000) == 0x5000) {
+        /* subi */
+        cpu.r[dh] = cpu_sub(cpu.r[dh], k, 0, false);
+    } else if ((op & 0xf000) == 0x4000) {
+        /* sbci */
+        cpu.r[dh] = cpu_sub(cpu.r[dh], k, cpu.sreg & SREG_C, true);
+    } else if ((op & 0xf000) == 0x6000) {
+        /* ori */
+        cpu.r[dh] |= k;
+        cpu_logic(cpu.r[dh]);
+    } else if ((op & 0xf800) == 0xb000) {
+        /* in */
+        cpu.r[d] = cpu_read_io((op & 0x0f) | ((op >> 5) & 0x30));
+    } else if ((op & 0xf800) == 0xb800) {
+        /* out */
+        cpu_write_io((op & 0x0f) | ((op >> 5) & 0x30), cpu.r[d]);
+    } else if ((op & 0xfc00) == 0x2c00) {
+        /* mov */
+        cpu.r[d] = cpu.r[r];
+    } else if ((op & 0xfc00) == 0x2400) {
+        /* eor, clr */
+        cpu.r[d] ^= cpu.r[r];
+        cpu_logic(cpu.r[d]);
+    } else if ((op & 0xfc00) == 0x1400) {
+        /* cp */
+        cpu_sub(cpu.r[d], cpu.r[r], 0, false);
+    } else if ((op & 0xfc00) == 0x0400) {
+        /* cpc */
+        cpu_sub(cpu.r[d], cpu.r[r], cpu.sreg & SREG_C, true);
+    } else if ((op & 0xec00) == 0x0c00) {
+        /* add, lsl, adc, rol */
+        uint8_t a = cpu.r[d], b = cpu.r[r];
+        uint8_t res = a + b + ((op & 0x1000) && (cpu.sreg & SREG_C) ? 1 : 0);
+        uint8_t carry = (a & b) | (b & ~res) | (~res & a);
+        uint8_t flags = (carry & 0x80 ? SREG_C : 0) | (carry & 0x08 ? SREG_H : 0)
+            | (res == 0 ? SREG_Z : 0) | (res & 0x80 ? SREG_N : 0);
+        if (((a & b & ~res) | (~a & ~b & res)) & 0x80)
+            flags |= SREG_V;
+        cpu_flags(SREG_C | SREG_Z | SREG_N | SREG_V | SREG_S | SREG_H, flags);
+        cpu.r[d] = res;
+    } else if ((op & 0xff00) == 0x0100) {
+        /* movw */
+        cpu.r[(op >> 3) & 0x1e] = cpu.r[(op << 1) & 0x1e];
+        cpu.r[((op >> 3) & 0x1e) + 1] = cpu.r[((op << 1) & 0x1e) + 1];
+    } else if ((op & 0xff00) == 0x9600) {
+        /* adiw */
+        uint8_t w = 24 + ((op >> 3) & 0x06);
+        uint16_t a = cpu.r[w] | cpu.r[w+1] << 8;
+        uint16_t res = a + ((op & 0x0f) | ((op >> 2) & 0x30));
+        uint8_t flags = (res == 0 ? SREG_Z : 0) | (res & 0x8000 ? SREG_N : 0);
+        if (~res & a & 0x8000)
+            flags |= SREG_C;
+        if (res & ~a & 0x8000)
+            flags |= SREG_V;
+        cpu_flags(SREG_C | SREG_Z | SREG_N | SREG_V | SREG_S, flags);
+        cpu.r[w] = res;
+        cpu.r[w+1] = res >> 8;
+        cpu.cycles++;
+    } else if ((op & 0xfe0f) == 0x940a) {
+        /* dec */
+        uint8_t res = cpu.r[d] - 1;
+        cpu_flags(SREG_Z | SREG_N | SREG_V | SREG_S, (res == 0 ? SREG_Z : 0)
+                | (res & 0x80 ? SREG_N : 0) | (res == 0x7f ? SREG_V : 0));
+        cpu.r[d] = res;
+    } else if ((op & 0xfe0f) == 0x9406) {
+        /* lsr */
+        cpu.r[d] = cpu_shift(cpu.r[d], 0);
+    } else if ((op & 0xfe0f) == 0x9407) {
+        /* ror */
+        cpu.r[d] = cpu_shift(cpu.r[d], cpu.sreg & SREG_C ? 0x80 : 0);
+    } else if (op == 0x9488 || op == 0x9408) {
+        /* clc, sec */
+        cpu_flags(SREG_C, op == 0x9408 ? SREG_C : 0);
+    } else if ((op & 0xfe08) == 0xfa00) {
+        /* bst */
+        cpu_flags(SREG_T, cpu.r[d] & _BV(bit) ? SREG_T : 0);
+    } else if ((op & 0xfe08) == 0xf800) {
+        /* bld */
+        if (cpu.sreg & SREG_T)
+            cpu.r[d] |= _BV(bit);
+        else
+            cpu.r[d] &= ~_BV(bit);
+    } else if (op == 0x94f8) {
+        /* cli, interrupts are never enabled */
+    } else if ((op & 0xfd00) == 0x9800) {
+        /* cbi, sbi */
+        uint8_t data = cpu_read_io(io);
+        if (io == cpu.device->pinb)
+            data = cpu.portb;
+        if (op & 0x0200)
+            data |= _BV(bit);
+        else
+            data &= ~_BV(bit);
+        if (io != cpu.device->pinb)
+            cpu_write_io(io, data);
+        cpu.cycles++;
+    } else if ((op & 0xfd00) == 0x9900) {
+        /* sbic, sbis */
+        if (((cpu_read_io(io) >> bit) & 1) == ((op >> 9) & 1))
+            cpu_skip();
+    } else if ((op & 0xfc08) == 0xfc00) {
+        /* sbrc, sbrs */
+        if (((cpu.r[d] >> bit) & 1) == ((op >> 9) & 1))
+            cpu_skip();
+    } else if ((op & 0xf800) == 0xf000) {
+        /* brbs, brbc */
+        if (((cpu.sreg >> bit) & 1) != ((op >> 10) & 1)) {
+            cpu.pc += (int8_t)(op >> 2) >> 1;
+            cpu.cycles++;
+        }
+    } else if ((op & 0xfe0f) == 0x9005) {
+        /* lpm Rd, Z+ */
+        uint16_t z = cpu.r[30] | cpu.r[31] << 8;
+        if (z < cpu.nrww && cpu.rwwsb) {
+            cpu_violation();
+            return;
+        }
+        cpu.r[d] = target_flash[z % cpu.device->flash_size];
+        z++;
+        cpu.r[30] = z;
+        cpu.r[31] = z >> 8;
+        cpu.cycles += 2;
+    } else if ((op & 0xfc0f) == 0x900d) {
+        /* ld Rd, X+ and st X+, Rr */
+        uint16_t x = cpu.r[26] | cpu.r[27] << 8;
+        if (x < 0x60 || x >= sizeof(cpu.ram)) {
+            cpu_violation();
+            return;
+        }
+        if (op & 0x0200)
+            cpu.ram[x] = cpu.r[d];
+        else
+            cpu.r[d] = cpu.ram[x];
+        x++;
+        cpu.r[26] = x;
+        cpu.r[27] = x >> 8;
+        cpu.cycles++;
+    } else if (op == 0x95e8) {
+        /* spm */
+        cpu_spm();
+        cpu.cycles += 3;
+    } else {
+        cpu_violation();
+        return;
+    }
+
+    cpu.pc %= cpu.device->flash_size / 2;
+    if ((uint32_t)cpu.pc * 2 < cpu.boot)
+        cpu.running = false;
+}
+
+/* run the core up to the time until */
+static void cpu_run(uint64_t until)
+{
+    while (cpu.running && cpu_now() < until)
+        cpu_step();
+}
+
+bool cpu_stop(void)
+{
+    if (!cpu.running)
+        return true;
+
+    cpu_run(sim_cycles);
+    cpu.running = false;
+
+    /* the core is ahead of the programmer by at most an instruction, unless
+     * it is halted */
+    uint64_t now = sim_cycles < cpu.start ? 0 : (sim_cycles - cpu.start) * cpu.clock / F_CPU;
+    return now >= cpu.busy_until && now >= cpu.halt_until;
+}
+
+static bool cpu_miso_pin(void)
+{
+    if (!cpu.running || !(cpu.ddrb & _BV(CPU_MISO)))
+        return true;
+    return cpu.portb & _BV(CPU_MISO);
+}
+
+bool cpu_miso(void)
+{
+    cpu_run(sim_cycles);
+    return cpu_miso_pin();
+}
+
+uint8_t cpu_transfer(uint8_t data, uint32_t half_period)
+{
+    uint8_t in = 0;
+
+    cpu_run(sim_cycles);
+    bus.start = sim_cycles;
+    bus.half_period = half_period;
+    bus.data = data;
+
+    /* miso is sampled on the rising edges */
+    for (uint8_t i = 0; i < 8; i++) {
+        cpu_run(bus.start + (2*i + 1) * (uint64_t)half_period);
+        in = in << 1 | cpu_miso_pin();
+    }
+
+    return in;
+}
@@ -0,0 +1,54 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __HOST_CPU_H
+#define __HOST_CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "target.h"
+
+/* avr core of the simulated target, it runs the loader stub (stubs/loader.S)
+ * from target_flash when the device leaves reset into the boot section.
+ * implemented are the instructions the stub uses, port b with the isp pins
+ * and self-programming with the page write times of the device.
+ *
+ * unknown instructions, an spm while the previous one is busy and reading
+ * the rww section while it is busy are violations and stop the core.
+ * leaving the boot section stops it silently, there is no application */
+
+/* start at pc (byte address) after the start-up time of the device */
+void cpu_start(const struct target_device_t *device, uint32_t clock, uint32_t pc);
+/* reset, returns false if self-programming was still busy */
+bool cpu_stop(void);
+bool cpu_running(void);
+
+/* MISO now, high while the core does not drive it */
+bool cpu_miso(void);
+/* hardware spi transfer starting now (mode 0, msb first), half_period in
+ * cycles of the programmer, returns the byte sampled on MISO */
+uint8_t cpu_transfer(uint8_t data, uint32_t half_period);
+
+#endif
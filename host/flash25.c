@@ -0,0 +1,200 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sim.h"
+#include "flash25.h"
+
+#define WIP     _BV(0)
+#define WEL     _BV(1)
+
+uint8_t flash25_memory[FLASH25_SIZE];
+struct flash25_stats_t flash25_stats;
+bool flash25_fitted;
+
+static struct {
+    bool selected;
+    uint8_t status;
+    uint64_t busy_until;
+    uint8_t command;
+    uint8_t pos;            /* bytes received since select */
+    uint32_t address;
+    uint8_t out;
+    /* page program: data is latched until deselect */
+    uint8_t page[FLASH25_PAGESIZE];
+    bool page_used;
+} chip;
+
+void flash25_init(void)
+{
+    flash25_fitted = true;
+    memset(&chip, 0, sizeof(chip));
+    memset(&flash25_stats, 0, sizeof(flash25_stats));
+    memset(flash25_memory, 0xff, sizeof(flash25_memory));
+    /* block protection set after power up */
+    chip.status = 0x1c;
+}
+
+static bool flash25_busy(void)
+{
+    if ((chip.status & WIP) && sim_cycles >= chip.busy_until)
+        chip.status &= ~(WIP | WEL);
+
+    return chip.status & WIP;
+}
+
+static void flash25_start(uint32_t us)
+{
+    chip.status |= WIP;
+    chip.busy_until = sim_cycles + (uint64_t)us * (F_CPU/1000000);
+}
+
+void flash25_select(bool active)
+{
+    if (active) {
+        chip.selected = true;
+        chip.pos = 0;
+        chip.out = 0xff;
+        return;
+    }
+
+    if (!chip.selected)
+        return;
+    chip.selected = false;
+
+    /* program and erase start at the end of the command */
+    if (chip.command == 0x02 && chip.page_used) {
+        uint32_t base = chip.address & ~(FLASH25_PAGESIZE-1UL);
+        for (uint16_t i = 0; i < FLASH25_PAGESIZE; i++)
+            flash25_memory[(base + i) % FLASH25_SIZE] &= chip.page[i];
+        chip.page_used = false;
+        flash25_stats.programs++;
+        flash25_start(FLASH25_PROGRAM_TIME);
+    } else if (chip.command == 0x20 && chip.pos == 4) {
+        uint32_t base = chip.address & ~(FLASH25_SECTORSIZE-1UL);
+        memset(&flash25_memory[base % FLASH25_SIZE], 0xff, FLASH25_SECTORSIZE);
+        flash25_stats.erases++;
+        flash25_start(FLASH25_ERASE_TIME);
+    }
+    chip.command = 0;
+}
+
+uint8_t flash25_out(void)
+{
+    return chip.selected ? chip.out : 0xff;
+}
+
+void flash25_in(uint8_t data)
+{
+    if (!chip.selected)
+        return;
+
+    flash25_stats.bytes++;
+    uint8_t pos = chip.pos < 255 ? chip.pos++ : 255;
+
+    if (pos == 0) {
+        chip.command = data;
+        chip.address = 0;
+
+        if (data == 0x05) {
+            flash25_busy();
+            chip.out = chip.status;
+            return;
+        }
+
+        if (flash25_busy()) {
+            flash25_stats.violations++;
+            chip.command = 0;
+            return;
+        }
+
+        switch (data) {
+            case 0x06:
+                chip.status |= WEL;
+                break;
+            case 0x04:
+                chip.status &= ~WEL;
+                break;
+            case 0x01:
+            case 0x02:
+            case 0x20:
+                if (!(chip.status & WEL)) {
+                    flash25_stats.violations++;
+                    chip.command = 0;
+                }
+                break;
+            case 0x03:
+                break;
+            case 0x9f:
+                chip.out = 0xef;
+                break;
+            default:
+                chip.command = 0;
+                break;
+        }
+        return;
+    }
+
+    switch (chip.command) {
+        case 0x05:
+            flash25_busy();
+            chip.out = chip.status;
+            return;
+        case 0x9f:
+            chip.out = pos == 1 ? 0x40 : 0x13;
+            return;
+        case 0x01:
+            /* only the block protection bits are writable */
+            chip.status = (chip.status & (WIP | WEL)) | (data & 0x1c);
+            chip.status &= ~WEL;
+            chip.command = 0;
+            return;
+    }
+
+    if (pos < 4) {
+        chip.address = chip.address << 8 | data;
+        if (pos == 3 && chip.command == 0x03)
+            chip.out = flash25_memory[chip.address % FLASH25_SIZE];
+        if (pos == 3 && chip.command == 0x02) {
+            if (chip.status & 0x1c)
+                flash25_stats.violations++;
+            memset(chip.page, 0xff, sizeof(chip.page));
+        }
+        return;
+    }
+
+    if (chip.command == 0x03) {
+        chip.address++;
+        chip.out = flash25_memory[chip.address % FLASH25_SIZE];
+    } else if (chip.command == 0x02) {
+        /* the address wraps around within the page */
+        chip.page[chip.address & (FLASH25_PAGESIZE-1)] = data;
+        chip.address = (chip.address & ~(FLASH25_PAGESIZE-1UL))
+            | ((chip.address + 1) & (FLASH25_PAGESIZE-1));
+        chip.page_used = true;
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __HOST_FLASH25_H
+#define __HOST_FLASH25_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* simulated 25-series spi flash (512KiB, 256 byte pages, 4KiB sectors) on
+ * the storage pins, with write enable latch and program/erase times */
+
+#define FLASH25_SIZE        (512*1024UL)
+#define FLASH25_PAGESIZE    256
+#define FLASH25_SECTORSIZE  4096
+
+/* program and erase times in us, worst case for the erase */
+#define FLASH25_PROGRAM_TIME    700
+#define FLASH25_ERASE_TIME      400000
+
+extern uint8_t flash25_memory[FLASH25_SIZE];
+/* cleared to simulate a programmer without storage, MISO only sees the
+ * pull-up then */
+extern bool flash25_fitted;
+
+struct flash25_stats_t {
+    uint32_t bytes;
+    uint32_t programs;
+    uint32_t erases;
+    uint32_t violations;    /* commands while busy, writes without WREN */
+};
+
+extern struct flash25_stats_t flash25_stats;
+
+void flash25_init(void);
+/* chip select, active low */
+void flash25_select(bool active);
+uint8_t flash25_out(void);
+void flash25_in(uint8_t data);
+
+#endif
@@ -0,0 +1,855 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* runs a programming session like avrdude against the simulated target:
+ * chip erase, flash and eeprom write and verify, and reports spi bytes and
+ * simulated time for each step, the session can be recorded (-w) and a
+ * recorded one replayed instead (-r, see replay.h) */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <util/crc16.h>
+#include <avr/interrupt.h>
+#include "config.h"
+#include "sim.h"
+#include "target.h"
+#include "flash25.h"
+#include "session.h"
+#include "replay.h"
+#include "usb.h"
+#include "stub.h"
+#include "storage.h"
+#include "standalone.h"
+#include "patch.h"
+#include "profile.h"
+#include "debug.h"
+#include "telemetry.h"
+#include "pollstats.h"
+
+/* timer.h cannot be included, its timer_t clashes with the one of the host */
+uint32_t timer_now(void);
+uint32_t timer_ms(void);
+
+/* USBasp requests */
+#define FUNC_CONNECT        1
+#define FUNC_DISCONNECT     2
+#define FUNC_TRANSMIT       3
+#define FUNC_READFLASH      4
+#define FUNC_ENABLEPROG     5
+#define FUNC_WRITEFLASH     6
+#define FUNC_READEEPROM     7
+#define FUNC_WRITEEEPROM    8
+#define FUNC_SETLONGADDRESS 9
+#define FUNC_SETISPSCK      10
+
+/* additional requests */
+#define FUNC_STUB_LOAD      0x19
+#define FUNC_STUB_START     0x1a
+#define FUNC_STUB_FINISH    0x1b
+#define FUNC_STUB_CRC       0x1c
+#define FUNC_STORAGE_ERASE  0x20
+#define FUNC_STORAGE_WRITE  0x21
+#define FUNC_STORAGE_READ   0x22
+#define FUNC_STANDALONE_RUN 0x23
+#define FUNC_STANDALONE_RESULT 0x24
+#define FUNC_PATCH_SET      0x25
+#define FUNC_PATCH_COUNTER  0x26
+#define FUNC_PATCH_SET_COUNTER 0x27
+#define FUNC_UPDI_CONNECT   0x28
+#define FUNC_UPDI_DISCONNECT 0x29
+#define FUNC_UPDI_READ      0x2c
+#define FUNC_UPDI_WRITE     0x2d
+#define FUNC_UART_CONFIG    0x35
+#define FUNC_UART_READ      0x36
+#define FUNC_UART_WRITE     0x37
+#define FUNC_UART_STATUS    0x38
+#define FUNC_PROFILE_READ   0x3a
+#define FUNC_POLL_STATS     0x3c
+#define FUNC_POLL_RESET     0x3d
+#define FUNC_TRACE_READ     0x3e
+#define FUNC_TELEMETRY      0x3f
+#define FUNC_STUB_STATUS    0x43
+#define FUNC_STORAGE_STATUS 0x44
+#define FUNC_PATCH_ENABLE   0x45
+
+#define BLOCKFLAG_FIRST     1
+#define BLOCKFLAG_LAST      2
+
+/* block size used by avrdude, which also sends SETLONGADDRESS before each block */
+#define BLOCKSIZE           200
+
+static const uint8_t updi_signature[3] = { 0x1e, 0x94, 0x22 };
+
+static uint8_t image[TARGET_FLASH_MAX];
+static uint8_t buffer[TARGET_FLASH_MAX];
+static int errors;
+static FILE *record;
+
+static struct {
+    uint64_t cycles;
+    uint32_t spi_bytes;
+} step;
+
+static void step_start(void)
+{
+    step.cycles = sim_cycles;
+    step.spi_bytes = sim_stats.spi_bytes;
+}
+
+static void step_report(const char *name, uint32_t bytes)
+{
+    uint64_t us = SIM_US(sim_cycles - step.cycles);
+
+    printf("%-16s %8lu spi bytes %10.3f ms", name,
+            (unsigned long)(sim_stats.spi_bytes - step.spi_bytes), us / 1000.0);
+    if (bytes && us)
+        printf(" %8.0f bytes/s", bytes * 1e6 / us);
+    printf("\n");
+}
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("error: %s\n", what);
+        errors++;
+    }
+}
+
+static int request_in(uint8_t request, uint16_t value, uint16_t index, uint8_t *data, uint16_t len)
+{
+    int received = session_in(request, value, index, data, len);
+
+    if (record)
+        replay_record(record, true, request, value, index, len, data, received);
+    return received;
+}
+
+static int request_out(uint8_t request, uint16_t value, uint16_t index, const uint8_t *data, uint16_t len)
+{
+    if (record)
+        replay_record(record, false, request, value, index, len, data, len);
+    return session_out(request, value, index, data, len);
+}
+
+/* time spent on the host */
+static void host_wait(uint32_t us)
+{
+    if (record)
+        replay_record_wait(record, us);
+    sim_advance((uint64_t)us * (F_CPU/1000000));
+}
+
+static void write_memory(uint8_t request, const uint8_t *data, uint32_t size, uint16_t pagesize)
+{
+    for (uint32_t address = 0; address < size; address += BLOCKSIZE) {
+        uint16_t len = size - address < BLOCKSIZE ? size - address : BLOCKSIZE;
+        uint8_t flags = 0;
+
+        if (address == 0)
+            flags |= BLOCKFLAG_FIRST;
+        if (address + len == size)
+            flags |= BLOCKFLAG_LAST;
+
+        uint16_t index = (pagesize & 0xff) | (flags | (pagesize & 0xf00) >> 4) << 8;
+        request_in(FUNC_SETLONGADDRESS, address, address >> 16, NULL, 0);
+        check(request_out(request, address, index, data + address, len) == len, "write stalled");
+    }
+}
+
+static void read_memory(uint8_t request, uint8_t *data, uint32_t size)
+{
+    for (uint32_t address = 0; address < size; address += BLOCKSIZE) {
+        uint16_t len = size - address < BLOCKSIZE ? size - address : BLOCKSIZE;
+        request_in(FUNC_SETLONGADDRESS, address, address >> 16, NULL, 0);
+        check(request_in(request, address, 0, data + address, len) == len, "short read");
+    }
+}
+
+static uint8_t transmit(uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4)
+{
+    uint8_t reply[4] = { 0 };
+
+    request_in(FUNC_TRANSMIT, b1 | b2 << 8, b3 | b4 << 8, reply, 4);
+    return reply[3];
+}
+
+#if defined(ENABLE_STANDALONE) || defined(ENABLE_PATCH)
+/* passes of the main loop of kahuna.c for ms milliseconds, usb_poll() must
+ * not be held off longer than a usb callback may take */
+static void main_loop(uint16_t ms)
+{
+    uint64_t end = sim_cycles + (uint64_t)ms * (F_CPU/1000);
+
+    session_poll_start();
+    while (sim_cycles < end) {
+        usb_poll();
+#ifdef ENABLE_TELEMETRY_LIFETIME
+        telemetry_poll();
+#endif
+#ifdef ENABLE_STANDALONE
+        standalone_poll();
+#endif
+#ifdef ENABLE_PATCH
+        patch_poll();
+#endif
+        sim_advance(F_CPU/100000);
+    }
+
+    check(session_stats.longest_poll <= SESSION_CALLBACK_LIMIT, "usb not polled for more than 50ms");
+}
+#endif
+
+#ifdef ENABLE_LOADER_STUB
+/* poll the pending stub operation like a host would, every millisecond */
+static uint8_t stub_wait(uint16_t *crc)
+{
+    uint8_t reply[3] = { STUB_BUSY };
+
+    for (uint16_t i = 0; i < 10000; i++) {
+        request_in(FUNC_STUB_STATUS, 0, 0, reply, 3);
+        if (reply[0] != STUB_BUSY)
+            break;
+        host_wait(1000);
+    }
+
+    if (crc)
+        *crc = reply[1] | reply[2] << 8;
+    return reply[0];
+}
+
+/* fastest hardware spi prescaler (SPR1:SPR0) with the target clock at least
+ * 32 times sck, -1 if there is none */
+static int stub_prescaler(uint32_t clock)
+{
+    static const uint8_t divider[] = { 4, 16, 64, 128 };
+
+    for (uint8_t i = 0; i < sizeof(divider); i++)
+        if ((uint64_t)clock * divider[i] >= 32ULL * F_CPU)
+            return i;
+
+    return -1;
+}
+#endif
+
+#ifdef ENABLE_STANDALONE
+/* poll the storage status until an erase is finished, every millisecond */
+static uint8_t storage_wait(void)
+{
+    uint8_t status = 0xff;
+
+    for (uint16_t i = 0; i < 1000; i++) {
+        request_in(FUNC_STORAGE_STATUS, 0, 0, &status, 1);
+        if (!(status & STORAGE_WIP))
+            break;
+        host_wait(1000);
+    }
+
+    return status;
+}
+
+/* erase the sectors for the image and write it to the storage */
+static void storage_upload(const uint8_t *data, uint32_t size)
+{
+    uint8_t reply;
+
+    for (uint32_t address = 0; address < size; address += FLASH25_SECTORSIZE) {
+        request_in(FUNC_STORAGE_ERASE, address, address >> 16, &reply, 1);
+        check(reply == 0, "storage erase failed");
+        check(!(storage_wait() & STORAGE_WIP), "storage erase timed out");
+    }
+
+    for (uint32_t address = 0; address < size; address += BLOCKSIZE) {
+        uint16_t len = size - address < BLOCKSIZE ? size - address : BLOCKSIZE;
+        check(request_out(FUNC_STORAGE_WRITE, address, address >> 16, data + address, len) == len,
+                "storage write stalled");
+    }
+}
+
+/* program the target from the storage, the run starts from the main loop
+ * and polls usb between pages, returns the result */
+static uint8_t standalone_run(void)
+{
+    uint8_t reply;
+
+    request_in(FUNC_STANDALONE_RUN, 0, 0, &reply, 1);
+    main_loop(1);
+    request_in(FUNC_STANDALONE_RESULT, 0, 0, &reply, 1);
+
+    return reply;
+}
+#endif
+
+#ifdef ENABLE_PATCH
+/* program the first flash page with patching enabled or not, corrupt the
+ * target before the disconnect if asked to, returns the counter afterwards */
+static uint32_t patch_session(const struct target_device_t *device, bool enable, bool corrupt)
+{
+    uint8_t reply[4];
+
+    request_in(FUNC_PATCH_ENABLE, enable, 0, reply, 1);
+    request_in(FUNC_CONNECT, 0, 0, reply, 4);
+    request_in(FUNC_ENABLEPROG, 0, 0, reply, 4);
+    transmit(0xac, 0x80, 0, 0);
+    host_wait(device->chip_erase);
+    write_memory(FUNC_WRITEFLASH, image, device->flash_pagesize, device->flash_pagesize);
+    if (corrupt)
+        target_flash[0x10] ^= 1;
+    request_in(FUNC_DISCONNECT, 0, 0, reply, 4);
+
+    request_in(FUNC_PATCH_COUNTER, 0, 0, reply, 4);
+    return reply[0] | reply[1] << 8 | reply[2] << 16 | (uint32_t)reply[3] << 24;
+}
+#endif
+
+#ifdef ENABLE_TELEMETRY
+/* counter of a FUNC_TELEMETRY record */
+static uint32_t telemetry_counter(const uint8_t *record, uint8_t counter)
+{
+    uint32_t value;
+
+    memcpy(&value, record + 2 + 4*counter, 4);
+    return value;
+}
+#endif
+
+static void report_totals(void)
+{
+    printf("total            %8lu spi bytes %10.3f ms (%.3f ms in delays, %.3f ms waiting "
+            "for write cycles)\n",
+            (unsigned long)sim_stats.spi_bytes, SIM_US(sim_cycles) / 1000.0,
+            SIM_US(sim_stats.delay_cycles) / 1000.0, SIM_US(target_stats.wait_cycles) / 1000.0);
+    printf("target: %lu instructions, %lu page writes, %lu eeprom writes, "
+            "%lu busy polls, %lu garbled bytes, %lu violations\n",
+            (unsigned long)target_stats.instructions, (unsigned long)target_stats.page_writes,
+            (unsigned long)target_stats.eeprom_writes, (unsigned long)target_stats.busy_polls,
+            (unsigned long)target_stats.garbled, (unsigned long)target_stats.violations);
+
+    uint8_t longest = 0;
+    bool slow = false;
+    for (uint16_t i = 0; i < 256; i++) {
+        if (session_stats.longest[i] > session_stats.longest[longest])
+            longest = i;
+        if (i != FUNC_WRITEEEPROM && session_stats.longest[i] > SESSION_CALLBACK_LIMIT)
+            slow = true;
+    }
+    printf("longest usb callback %.3f ms (request 0x%02x)\n",
+            SIM_US(session_stats.longest[longest]) / 1000.0, longest);
+
+    check(target_stats.violations == 0, "protocol violations");
+    check(!slow, "usb callback longer than 50ms");
+}
+
+static int replay(const char *name)
+{
+    FILE *f = fopen(name, "r");
+
+    if (!f) {
+        perror(name);
+        return 2;
+    }
+
+    bool ok = replay_run(f, name);
+    fclose(f);
+    check(ok, "replay aborted");
+
+    printf("replay %s: %lu transfers, %lu stalled, %lu with other data than recorded\n", name,
+            (unsigned long)replay_stats.transfers, (unsigned long)replay_stats.stalls,
+            (unsigned long)replay_stats.mismatches);
+    check(replay_stats.mismatches == 0, "replayed data differs");
+    report_totals();
+
+    return errors ? 1 : 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-d atmega8|atmega328p] [-c target clock] [-s sck option]\n"
+            "       [-f flash bytes] [-e eeprom bytes] [-w record file | -r replay file]\n", name);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    const struct target_device_t *device = &target_atmega8;
+    uint32_t clock = 1000000;
+    uint8_t sck = 0;
+    long flash_bytes = -1, eeprom_bytes = -1;
+    const char *replay_name = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:c:s:f:e:w:r:")) != -1) {
+        switch (opt) {
+            case 'd':
+                if (strcmp(optarg, "atmega8") == 0)
+                    device = &target_atmega8;
+                else if (strcmp(optarg, "atmega328p") == 0)
+                    device = &target_atmega328p;
+                else
+                    usage(argv[0]);
+                break;
+            case 'c': clock = strtoul(optarg, NULL, 0); break;
+            case 's': sck = strtoul(optarg, NULL, 0); break;
+            case 'f': flash_bytes = strtol(optarg, NULL, 0); break;
+            case 'e': eeprom_bytes = strtol(optarg, NULL, 0); break;
+            case 'w':
+                record = fopen(optarg, "w");
+                if (!record) {
+                    perror(optarg);
+                    return 2;
+                }
+                break;
+            case 'r': replay_name = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+
+    if (flash_bytes < 0 || flash_bytes > (long)device->flash_size)
+        flash_bytes = device->flash_size;
+    if (eeprom_bytes < 0 || eeprom_bytes > (long)device->eeprom_size)
+        eeprom_bytes = device->eeprom_size;
+
+    sim_init();
+    target_init(device, clock);
+    flash25_init();
+    target_updi_init(updi_signature);
+    session_init();
+
+    if (replay_name) {
+        printf("%s at %lu Hz\n", device->name, (unsigned long)clock);
+        return replay(replay_name);
+    }
+
+    printf("%s at %lu Hz, sck option %u, %ld flash and %ld eeprom bytes\n",
+            device->name, (unsigned long)clock, sck, flash_bytes, eeprom_bytes);
+
+    srand(1);
+    for (uint32_t i = 0; i < flash_bytes; i++)
+        image[i] = rand();
+
+    uint8_t reply[4];
+
+    step_start();
+    request_in(FUNC_SETISPSCK, sck, 0, reply, 4);
+    request_in(FUNC_CONNECT, 0, 0, reply, 4);
+    request_in(FUNC_ENABLEPROG, 0, 0, reply, 4);
+    check(reply[0] == 0, "programming enable failed");
+    step_report("connect", 0);
+
+#if defined(DEBUG) && !defined(DEBUG_UART)
+    /* the trace holds the events of the connect in order */
+    struct debug_event_t trace[DEBUG_EVENTS];
+    int got = request_in(FUNC_TRACE_READ, 0, 0, (uint8_t *)trace, sizeof(trace));
+    int events = got / (int)sizeof(struct debug_event_t);
+    check(events >= 4 && trace[0].event == DEBUG_BOOT && trace[1].event == DEBUG_CONNECT
+            && trace[2].event == DEBUG_ENABLEPROG && trace[events-1].event == DEBUG_ATTACHED,
+            "wrong debug trace of the connect");
+    for (int i = 1; i < events; i++)
+        check(trace[i].event != DEBUG_LOST && (uint16_t)(trace[i].time - trace[i-1].time) < 0x8000,
+                "debug trace out of order");
+    check(request_in(FUNC_TRACE_READ, 0, 0, (uint8_t *)trace, sizeof(trace)) == 0,
+            "debug trace not drained");
+#endif
+
+    step_start();
+    uint8_t signature[3];
+    for (uint8_t i = 0; i < 3; i++)
+        signature[i] = transmit(0x30, 0, i, 0);
+    check(memcmp(signature, device->signature, 3) == 0, "wrong signature");
+    step_report("signature", 0);
+
+    /* avrdude waits for the chip erase delay of the part */
+    step_start();
+    transmit(0xac, 0x80, 0, 0);
+    host_wait(device->chip_erase);
+    step_report("chip erase", 0);
+
+    step_start();
+    write_memory(FUNC_WRITEFLASH, image, flash_bytes, device->flash_pagesize);
+    step_report("write flash", flash_bytes);
+
+    step_start();
+    read_memory(FUNC_READFLASH, buffer, flash_bytes);
+    step_report("verify flash", flash_bytes);
+    check(memcmp(buffer, image, flash_bytes) == 0, "flash read back differs");
+    check(memcmp(target_flash, image, flash_bytes) == 0, "flash contents differ");
+
+    for (uint32_t i = 0; i < eeprom_bytes; i++)
+        image[i] = i * 7;
+
+    step_start();
+    write_memory(FUNC_WRITEEEPROM, image, eeprom_bytes, 0);
+    step_report("write eeprom", eeprom_bytes);
+
+    step_start();
+    read_memory(FUNC_READEEPROM, buffer, eeprom_bytes);
+    step_report("verify eeprom", eeprom_bytes);
+    check(memcmp(buffer, image, eeprom_bytes) == 0, "eeprom read back differs");
+    check(memcmp(target_eeprom, image, eeprom_bytes) == 0, "eeprom contents differ");
+
+    request_in(FUNC_DISCONNECT, 0, 0, reply, 4);
+
+#ifdef ENABLE_TELEMETRY
+    /* counters of the session above, polling reads are not counted */
+    uint8_t counters[TELEMETRY_RECORD];
+    check(request_in(FUNC_TELEMETRY, 0, 0, counters, sizeof(counters)) == sizeof(counters)
+            && counters[0] == TELEMETRY_VERSION, "telemetry record incomplete");
+    check(telemetry_counter(counters, TELEMETRY_ATTACHES) == 1
+            && telemetry_counter(counters, TELEMETRY_FLASH_WRITTEN) == (uint32_t)flash_bytes
+            && telemetry_counter(counters, TELEMETRY_FLASH_READ) == (uint32_t)flash_bytes
+            && telemetry_counter(counters, TELEMETRY_EEPROM_WRITTEN) == (uint32_t)eeprom_bytes
+            && telemetry_counter(counters, TELEMETRY_EEPROM_READ) == (uint32_t)eeprom_bytes,
+            "wrong telemetry counters");
+    check(telemetry_counter(counters, TELEMETRY_POLL_TIMEOUTS) == 0, "telemetry poll timeouts");
+
+#ifdef ENABLE_TELEMETRY_LIFETIME
+    /* the disconnect took the sums, which are saved in the background while
+     * the next session changes the counters */
+    uint8_t lifetime[TELEMETRY_RECORD];
+    request_in(FUNC_TELEMETRY, 1, 0, lifetime, sizeof(lifetime));
+    check(memcmp(lifetime, counters, sizeof(lifetime)) == 0, "wrong lifetime telemetry counters");
+
+    step_start();
+    request_in(FUNC_CONNECT, 0, 0, reply, 4);
+    request_in(FUNC_ENABLEPROG, 0, 0, reply, 4);
+    for (uint16_t ms = 0; ms < 2 * TELEMETRY_COUNTERS * 4 * HOST_EEPROM_WRITE_US / 1000; ms++) {
+        usb_poll();
+        telemetry_poll();
+        if (ms == 100)
+            read_memory(FUNC_READFLASH, buffer, BLOCKSIZE);
+        host_wait(1000);
+    }
+    request_in(FUNC_DISCONNECT, 0, 0, reply, 4);
+    step_report("telemetry save", 0);
+    check(memcmp(eeprom_storage.telemetry, lifetime + 2, sizeof(eeprom_storage.telemetry)) == 0,
+            "saved telemetry counters differ from the sums at the disconnect");
+#endif
+#endif
+
+#ifdef ENABLE_LOADER_STUB
+    /* flash below the smallest boot section written via the loader stub,
+     * which runs on the core of the target, checked by its checksum, then
+     * the stub erases itself */
+    int prescaler = stub_prescaler(clock);
+    if (prescaler < 0) {
+        printf("stub skipped, the target clock is below 32 times the slowest sck\n");
+    } else {
+        uint32_t boot = device->flash_size - device->boot_min;
+        uint32_t stub_bytes = flash_bytes < boot ? flash_bytes : boot;
+        uint16_t expected = 0xffff;
+        for (uint32_t i = 0; i < stub_bytes; i++) {
+            image[i] = rand();
+            expected = _crc16_update(expected, image[i]);
+        }
+
+        step_start();
+        request_in(FUNC_CONNECT, 0, 0, reply, 4);
+        request_in(FUNC_ENABLEPROG, 0, 0, reply, 4);
+        check(reply[0] == 0, "programming enable failed");
+        transmit(0xac, 0x80, 0, 0);
+        host_wait(device->chip_erase);
+
+        request_in(FUNC_STUB_LOAD, boot, device->stub_image, reply, 3);
+        check(reply[0] == 0 && (reply[1] | reply[2] << 8) == device->flash_pagesize,
+                "stub load failed");
+        check(stub_wait(NULL) == STUB_DONE, "stub not loaded");
+
+        /* without BOOTRST the device does not run the stub, the idle MISO
+         * line must not be taken for it */
+        request_in(FUNC_STUB_START, prescaler, 0, reply, 1);
+        check(reply[0] == 0, "stub start failed");
+        check(stub_wait(NULL) == STUB_FAILED, "stub not running, but started");
+        request_in(FUNC_STUB_FINISH, 0, 0, reply, 1);
+        stub_wait(NULL);
+        check(transmit(0x30, 0, 0, 0) == device->signature[0],
+                "not in programming mode after a failed stub start");
+
+        /* BOOTRST programmed, BOOTSZ 11 */
+        uint8_t high = transmit(0x58, 0x08, 0, 0);
+        transmit(0xac, 0xa8, 0, (high & ~0x07) | 0x06);
+        host_wait(device->fuse_write);
+
+        request_in(FUNC_STUB_START, prescaler, 0, reply, 1);
+        check(reply[0] == 0, "stub start failed");
+        check(stub_wait(NULL) == STUB_DONE, "stub not ready");
+        step_report("stub start", 0);
+
+        step_start();
+        write_memory(FUNC_WRITEFLASH, image, stub_bytes, device->flash_pagesize);
+        step_report("stub write", stub_bytes);
+
+        step_start();
+        uint16_t crc;
+        request_in(FUNC_STUB_CRC, stub_bytes, 0, reply, 1);
+        check(reply[0] == 0, "stub checksum failed");
+        check(stub_wait(&crc) == STUB_DONE, "no stub checksum");
+        step_report("stub checksum", stub_bytes);
+        check(crc == expected, "stub checksum differs");
+
+        step_start();
+        request_in(FUNC_STUB_FINISH, 0, 0, reply, 1);
+        check(reply[0] == 0, "stub finish failed");
+        check(stub_wait(NULL) == STUB_DONE, "not in programming mode after the stub");
+        transmit(0xac, 0xa8, 0, high);
+        host_wait(device->fuse_write);
+        request_in(FUNC_DISCONNECT, 0, 0, reply, 4);
+        step_report("stub finish", 0);
+
+        check(memcmp(target_flash, image, stub_bytes) == 0, "stub flash contents differ");
+        for (uint32_t i = boot; i < device->flash_size; i++)
+            if (target_flash[i] != 0xff) {
+                check(false, "stub not erased");
+                break;
+            }
+    }
+#endif
+
+#ifdef ENABLE_STANDALONE
+    /* image storage round trip, one sector */
+    for (uint32_t i = 0; i < FLASH25_SECTORSIZE; i++)
+        image[i] = i ^ (i >> 8);
+
+    step_start();
+    storage_upload(image, FLASH25_SECTORSIZE);
+    for (uint32_t address = 0; address < FLASH25_SECTORSIZE; address += BLOCKSIZE) {
+        uint16_t len = FLASH25_SECTORSIZE - address < BLOCKSIZE ? FLASH25_SECTORSIZE - address : BLOCKSIZE;
+        request_in(FUNC_STORAGE_READ, address, address >> 16, buffer + address, len);
+    }
+    step_report("storage", FLASH25_SECTORSIZE);
+    check(memcmp(buffer, image, FLASH25_SECTORSIZE) == 0, "storage read back differs");
+    check(memcmp(flash25_memory, image, FLASH25_SECTORSIZE) == 0, "storage contents differ");
+    check(flash25_stats.violations == 0, "storage protocol violations");
+
+    /* standalone image: header, flash pages with a blank one in between,
+     * eeprom with erased bytes, and EESAVE programmed in the high fuse */
+    struct standalone_header_t header = {
+        .magic = STANDALONE_MAGIC,
+        .flags = STANDALONE_FLAG_SIGNATURE | _BV(1),
+        .pagesize = device->flash_pagesize,
+        .pages = 8,
+        .eeprom_size = 64,
+        .fuses = { 0, device->fuses[1] & ~_BV(3) },
+    };
+    uint32_t flash_size = (uint32_t)header.pages * header.pagesize;
+    uint8_t *flash = image + STANDALONE_DATA, *eeprom = flash + flash_size;
+    uint32_t image_size = STANDALONE_DATA + flash_size + header.eeprom_size;
+    uint16_t eeprom_used = 0;
+
+    memset(image, 0xff, sizeof(image));
+    memcpy(image, &header, sizeof(header));
+    for (uint32_t i = 0; i < flash_size; i++)
+        if (i / header.pagesize != 3)
+            flash[i] = rand();
+    for (uint16_t i = 0; i < header.eeprom_size; i++) {
+        eeprom[i] = i % 3 ? i : 0xff;
+        eeprom_used += eeprom[i] != 0xff;
+    }
+
+    /* a bad header and a wrong signature do not touch the target */
+    memcpy(buffer, target_flash, device->flash_size);
+    image[0] ^= 0xff;
+    storage_upload(image, image_size);
+    check(standalone_run() == STANDALONE_ERR_IMAGE, "bad standalone image accepted");
+    image[0] ^= 0xff;
+
+    header.signature[2] = device->signature[2] ^ 1;
+    memcpy(image, &header, sizeof(header));
+    storage_upload(image, image_size);
+    check(standalone_run() == STANDALONE_ERR_SIGNATURE, "wrong standalone signature accepted");
+    check(memcmp(target_flash, buffer, device->flash_size) == 0, "target changed despite errors");
+
+    memcpy(header.signature, device->signature, 3);
+    memcpy(image, &header, sizeof(header));
+    storage_upload(image, image_size);
+
+    step_start();
+    uint32_t eeprom_writes = target_stats.eeprom_writes;
+    check(standalone_run() == STANDALONE_OK, "standalone programming failed");
+    step_report("standalone", flash_size + header.eeprom_size);
+    printf("longest usb poll gap %.3f ms\n", SIM_US(session_stats.longest_poll) / 1000.0);
+    check(memcmp(target_flash, flash, flash_size) == 0, "standalone flash contents differ");
+    for (uint32_t i = flash_size; i < device->flash_size; i++)
+        if (target_flash[i] != 0xff) {
+            check(false, "standalone flash not erased");
+            break;
+        }
+    check(memcmp(target_eeprom, eeprom, header.eeprom_size) == 0,
+            "standalone eeprom contents differ");
+    check(target_stats.eeprom_writes - eeprom_writes == eeprom_used,
+            "erased eeprom bytes written");
+    check(target_fuses[1] == header.fuses[1], "standalone fuse not written");
+    memcpy(target_fuses, device->fuses, sizeof(target_fuses));
+
+    /* without storage, power-up must not hang and programming fails */
+    flash25_fitted = false;
+    check(!storage_init(), "missing storage not detected");
+    request_in(FUNC_STORAGE_STATUS, 0, 0, reply, 1);
+    check(reply[0] == 0xff, "missing storage not reported");
+    request_in(FUNC_STORAGE_ERASE, 0, 0, reply, 1);
+    check(reply[0] != 0, "missing storage erased");
+    check(standalone_run() == STANDALONE_ERR_STORAGE, "missing storage not reported");
+    flash25_fitted = true;
+#endif
+
+#ifdef ENABLE_PATCH
+    /* serial number as four hex digits at 0x10 of the flash, only patched
+     * when enabled, the counter only advances when the target has it */
+    for (uint32_t i = 0; i < device->flash_pagesize; i++)
+        image[i] = rand();
+    request_in(FUNC_PATCH_SET, 0x10, 4 | PATCH_HEX << 12, reply, 1);
+    request_in(FUNC_PATCH_SET_COUNTER, 0x1234, 0, reply, 1);
+    check(patch_session(device, true, false) == 0x1235, "patch counter not advanced");
+    check(memcmp(target_flash + 0x10, "1234", 4) == 0, "flash not patched");
+    check(patch_session(device, false, false) == 0x1235, "patch counter advanced without patching");
+    check(memcmp(target_flash, image, device->flash_pagesize) == 0, "flash patched without enable");
+    check(patch_session(device, true, true) == 0x1235, "patch counter advanced after a failed write");
+
+    /* the table and the counter reach the eeprom from the main loop, one
+     * write cycle at a time */
+    main_loop(200);
+    patch_init();
+    request_in(FUNC_PATCH_COUNTER, 0, 0, reply, 4);
+    check((reply[0] | reply[1] << 8) == 0x1235, "patch counter not saved");
+    request_in(FUNC_PATCH_SET, 0, 0, reply, 1);
+#endif
+
+#ifdef ENABLE_UPDI
+    /* updi target: signature and a block of sram */
+    step_start();
+    request_in(FUNC_UPDI_CONNECT, 0, 0, reply, 1);
+    check(reply[0] != 0, "updi connect failed");
+    request_in(FUNC_UPDI_READ, TARGET_UPDI_SIGNATURE, 0, buffer, 3);
+    check(memcmp(buffer, updi_signature, 3) == 0, "wrong updi signature");
+    request_out(FUNC_UPDI_WRITE, 0x3e00, 0, image, 64);
+    request_in(FUNC_UPDI_READ, 0x3e00, 0, buffer, 64);
+    request_in(FUNC_UPDI_DISCONNECT, 0, 0, reply, 1);
+    step_report("updi", 64);
+    check(memcmp(buffer, image, 64) == 0, "updi read back differs");
+    check(sim_stats.uart_bytes > 0, "nothing sent on the uart");
+#endif
+
+#ifdef ENABLE_UART_BRIDGE
+    /* the peer sends back to back at 115200 baud, while the host polls the
+     * bridge every millisecond and keeps its transmit buffer filled, usb
+     * packets hold off the uart interrupts */
+    step_start();
+    request_in(FUNC_UART_CONFIG, 115200 & 0xffff, 115200 >> 16, reply, 4);
+    check((reply[0] | reply[1] | reply[2] | reply[3]) != 0, "uart bridge not enabled");
+
+    uint16_t bridged = 1024, in = 0, out = 0, back = 0;
+    uint8_t uart_errors = 0;
+    uint64_t deadline = sim_cycles + F_CPU;
+    sim_uart_send(image, bridged);
+
+    while ((in < bridged || back < bridged) && sim_cycles < deadline) {
+        request_in(FUNC_UART_STATUS, 0, 0, reply, 3);
+        uart_errors |= reply[2];
+        if (reply[0])
+            in += request_in(FUNC_UART_READ, 0, 0, buffer + in, reply[0]);
+
+        uint16_t n = bridged - out < reply[1] ? bridged - out : reply[1];
+        if (n)
+            out += request_out(FUNC_UART_WRITE, 0, 0, image + bridged + out, n);
+
+        back += sim_uart_receive(buffer + bridged + back, bridged - back);
+        host_wait(1000);
+    }
+
+    step_report("uart bridge", 2 * bridged);
+    check(in == bridged && memcmp(buffer, image, bridged) == 0, "uart bridge received data differs");
+    check(back == bridged && memcmp(buffer + bridged, image + bridged, bridged) == 0,
+            "uart bridge sent data differs");
+    check(uart_errors == 0, "uart bridge lost data");
+#endif
+
+#ifdef ENABLE_PROFILE
+    /* the profile is longer than one control transfer, read it in parts,
+     * connect and write flash have entries of their own */
+    struct profile_t sections[PROFILE_SECTIONS];
+    uint16_t offset = 0;
+    int got;
+    do {
+        got = request_in(FUNC_PROFILE_READ, offset, 0, (uint8_t *)sections + offset, 255);
+        offset += got;
+    } while (got == 250);
+    check(offset == sizeof(sections), "profile incomplete");
+    check(sections[0].count > 0 && sections[0].count == profile[0].count,
+            "no profile of FUNC_CONNECT");
+    check(sections[5].count > 0 && sections[5].count == profile[5].count,
+            "no profile of FUNC_WRITEFLASH");
+#endif
+
+    /* the clock is extended by the timer2 overflow interrupt, it keeps
+     * counting while nobody reads it, and counts an overflow whose interrupt
+     * is still pending while interrupts are disabled (100 steps of 1024
+     * cycles, starting shortly before the overflow) */
+    check(TIMSK & _BV(TOIE2), "timer2 overflow interrupt not enabled");
+    uint32_t ms = timer_ms();
+    host_wait(100000);
+    ms = timer_ms() - ms;
+    check(ms >= 99 && ms <= 101, "clock lost time while not read");
+
+    while ((uint8_t)timer_now() < 0xf0)
+        host_wait(100);
+    uint32_t steps = timer_now();
+    cli();
+    host_wait(100 * 1024ULL * 1000000 / F_CPU);
+    uint32_t pending = timer_now() - steps;
+    sei();
+    host_wait(1);
+    steps = timer_now() - steps;
+    check(pending >= 99 && pending <= 101, "clock lost a pending overflow");
+    check(steps >= pending && steps <= pending + 1, "clock counted an overflow twice");
+
+#ifdef ENABLE_POLL_STATS
+    /* usb is not polled for 60ms after a reset, which must show up as the
+     * longest gap and in the 50-100ms bucket, gaps count timer steps of 1024
+     * cycles */
+    usb_poll();
+    request_in(FUNC_POLL_RESET, 0, 0, NULL, 0);
+    usb_poll();
+    host_wait(60000);
+    usb_poll();
+
+    struct poll_stats_t stats;
+    check(request_in(FUNC_POLL_STATS, 0, 0, (uint8_t *)&stats, sizeof(stats)) == sizeof(stats),
+            "poll stats incomplete");
+    printf("longest poll gap %.3f ms after request 0x%02x\n",
+            stats.max * 1024.0 * 1000 / F_CPU, stats.max_request);
+    check(stats.histogram[6] == 1, "60ms poll gap not in the 50-100ms bucket");
+    check(stats.max_request == FUNC_POLL_RESET, "wrong request before the longest poll gap");
+    check(stats.over & POLL_OVER_EEPROM, "eeprom writes not flagged as over 50ms");
+#endif
+
+    report_totals();
+
+    if (record)
+        fclose(record);
+
+    return errors ? 1 : 0;
+}
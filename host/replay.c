@@ -0,0 +1,152 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* replays recorded usb sessions (see replay.h) against the host build */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "session.h"
+#include "replay.h"
+
+#define REPLAY_MAXLEN   0xffff
+
+struct replay_stats_t replay_stats;
+
+static uint8_t data[REPLAY_MAXLEN];
+static uint8_t received[REPLAY_MAXLEN];
+
+/* returns the number of bytes or -1 */
+static int parse_hex(const char *s, uint8_t *buf, int max)
+{
+    int len = 0;
+
+    while (*s == ' ' || *s == '\t')
+        s++;
+
+    while (s[0] && s[0] != '\n' && s[0] != '\r') {
+        char byte[3] = { s[0], s[1], 0 };
+        char *end;
+
+        if (len == max || !s[1])
+            return -1;
+        buf[len++] = strtoul(byte, &end, 16);
+        if (*end)
+            return -1;
+        s += 2;
+    }
+
+    return len;
+}
+
+static bool replay_line(char *line)
+{
+    char dir[8];
+    unsigned request, value, index, length;
+    int pos;
+
+    if (sscanf(line, "%7s", dir) != 1 || dir[0] == '#')
+        return true;
+
+    if (strcmp(dir, "wait") == 0) {
+        unsigned long us;
+        if (sscanf(line, "%*s %lx", &us) != 1)
+            return false;
+        sim_advance((uint64_t)us * (F_CPU/1000000));
+        return true;
+    }
+
+    if (sscanf(line, "%*s %x %x %x %x%n", &request, &value, &index, &length, &pos) != 4
+            || request > 0xff || value > 0xffff || index > 0xffff || length > REPLAY_MAXLEN)
+        return false;
+
+    int len = parse_hex(line + pos, data, REPLAY_MAXLEN);
+    if (len < 0)
+        return false;
+
+    replay_stats.transfers++;
+
+    if (strcmp(dir, "out") == 0) {
+        if (len != (int)length)
+            return false;
+        if (session_out(request, value, index, data, length) == SESSION_STALL)
+            replay_stats.stalls++;
+    } else if (strcmp(dir, "in") == 0) {
+        int got = session_in(request, value, index, received, length);
+
+        if (got == SESSION_STALL)
+            replay_stats.stalls++;
+        else if (len && (got != len || memcmp(received, data, len) != 0))
+            replay_stats.mismatches++;
+    } else
+        return false;
+
+    return true;
+}
+
+bool replay_run(FILE *f, const char *name)
+{
+    char *line = NULL;
+    size_t size = 0;
+    unsigned number = 0;
+    bool ok = true;
+
+    memset(&replay_stats, 0, sizeof(replay_stats));
+
+    while (getline(&line, &size, f) != -1) {
+        number++;
+        if (!replay_line(line)) {
+            fprintf(stderr, "%s:%u: invalid transfer\n", name, number);
+            ok = false;
+            break;
+        }
+    }
+
+    free(line);
+    return ok;
+}
+
+void replay_record(FILE *f, bool in, uint8_t request, uint16_t value, uint16_t index,
+        uint16_t len, const uint8_t *data, int received)
+{
+    fprintf(f, "%s %02x %04x %04x %04x", in ? "in" : "out", request, value, index, len);
+
+    /* sent data, or the data received by an in transfer */
+    int n = in ? received : len;
+    if (n > 0) {
+        fputc(' ', f);
+        for (int i = 0; i < n; i++)
+            fprintf(f, "%02x", data[i]);
+    }
+    fputc('\n', f);
+}
+
+void replay_record_wait(FILE *f, uint32_t us)
+{
+    fprintf(f, "wait %lx\n", (unsigned long)us);
+}
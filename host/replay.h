@@ -0,0 +1,59 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __HOST_REPLAY_H
+#define __HOST_REPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* recorded control transfers, one per line, numbers in hex:
+ *
+ *   in <request> <value> <index> <length> [data received]
+ *   out <request> <value> <index> <length> <data sent>
+ *   wait <us>
+ *
+ * wait is time spent on the host (e.g. avrdude's chip erase delay), lines
+ * starting with # are ignored.  only usb is recorded, not what the uart
+ * bridge's peer sends */
+
+struct replay_stats_t {
+    uint32_t transfers;
+    uint32_t stalls;
+    uint32_t mismatches;    /* in transfers which returned other data than recorded */
+};
+
+extern struct replay_stats_t replay_stats;
+
+/* run the transfers from f against the firmware, returns false on a syntax
+ * error */
+bool replay_run(FILE *f, const char *name);
+
+void replay_record(FILE *f, bool in, uint8_t request, uint16_t value, uint16_t index,
+        uint16_t len, const uint8_t *data, int received);
+void replay_record_wait(FILE *f, uint32_t us);
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/interrupt.h>
+#include "config.h"
+#include "usbdrv.h"
+#include "usb.h"
+#include "timer.h"
+#include "debug.h"
+#include "patch.h"
+#include "telemetry.h"
+#include "standalone.h"
+#include "session.h"
+#include "sim.h"
+
+#define PACKET_SIZE 8
+
+/* the usb interrupt receives or sends a packet with its token and handshake
+ * in about 100us at low speed, other interrupts have to wait */
+#define PACKET_CYCLES (F_CPU/10000)
+
+/* replaces usbdrv.c */
+uchar *usbMsgPtr;
+
+void usbInit(void)
+{
+}
+
+struct session_stats_t session_stats;
+
+/* time of the last usbPoll() */
+static uint64_t last_poll;
+
+void usbPoll(void)
+{
+    if (sim_cycles - last_poll > session_stats.longest_poll)
+        session_stats.longest_poll = sim_cycles - last_poll;
+    last_poll = sim_cycles;
+}
+
+/* time of the running callback */
+static struct {
+    uint8_t request;
+    uint64_t start;
+} callback;
+
+static void callback_start(void)
+{
+    callback.start = sim_cycles;
+}
+
+static void callback_end(void)
+{
+    uint64_t cycles = sim_cycles - callback.start;
+
+    if (cycles > session_stats.longest[callback.request])
+        session_stats.longest[callback.request] = cycles;
+}
+
+void session_init(void)
+{
+    memset(&session_stats, 0, sizeof(session_stats));
+
+    /* like main() in kahuna.c */
+    debug_init();
+    usb_enable();
+    usb_init();
+    sei();
+    timer_init();
+#ifdef ENABLE_PATCH
+    patch_init();
+#endif
+#ifdef ENABLE_TELEMETRY
+    telemetry_init();
+#endif
+#ifdef ENABLE_STANDALONE
+    standalone_init();
+#endif
+}
+
+void session_poll_start(void)
+{
+    session_stats.longest_poll = 0;
+    last_poll = sim_cycles;
+}
+
+static usbMsgLen_t session_setup(uint8_t type, uint8_t request, uint16_t value,
+        uint16_t index, uint16_t len)
+{
+    uchar setup[8] = {
+        type, request,
+        value & 0xff, value >> 8,
+        index & 0xff, index >> 8,
+        len & 0xff, len >> 8,
+    };
+
+    callback.request = request;
+    sim_usb_interrupt(PACKET_CYCLES);
+    callback_start();
+    usbMsgLen_t reply = usbFunctionSetup(setup);
+    callback_end();
+
+    return reply;
+}
+
+int session_in(uint8_t request, uint16_t value, uint16_t index, uint8_t *data, uint16_t len)
+{
+    usbMsgLen_t reply = session_setup(0xc0, request, value, index, len);
+
+    if (reply != USB_NO_MSG) {
+        /* limited to the requested length */
+        if (reply > len)
+            reply = len;
+        memcpy(data, usbMsgPtr, reply);
+        return reply;
+    }
+
+    /* without long transfers, only the low byte of wLength is used */
+    uint16_t remaining = len & 0xff;
+    int received = 0;
+
+    while (remaining) {
+        uchar n = remaining < PACKET_SIZE ? remaining : PACKET_SIZE;
+        callback_start();
+        uchar got = usbFunctionRead(data + received, n);
+        callback_end();
+        sim_usb_interrupt(PACKET_CYCLES);
+
+        received += got;
+        remaining -= got;
+        /* a short packet ends the transfer */
+        if (got < n)
+            break;
+    }
+
+    return received;
+}
+
+int session_out(uint8_t request, uint16_t value, uint16_t index, const uint8_t *data, uint16_t len)
+{
+    usbMsgLen_t reply = session_setup(0x40, request, value, index, len);
+
+    if (reply != USB_NO_MSG)
+        return len;
+
+    for (uint16_t pos = 0; pos < len; pos += PACKET_SIZE) {
+        uchar packet[PACKET_SIZE];
+        uchar n = len - pos < PACKET_SIZE ? len - pos : PACKET_SIZE;
+
+        memcpy(packet, data + pos, n);
+        sim_usb_interrupt(PACKET_CYCLES);
+        callback_start();
+        uchar ret = usbFunctionWrite(packet, n);
+        callback_end();
+
+        if (ret == 0xff)
+            return SESSION_STALL;
+    }
+
+    return len;
+}
@@ -0,0 +1,59 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __HOST_SESSION_H
+#define __HOST_SESSION_H
+
+#include <stdint.h>
+
+/* control transfers to the firmware as v-usb would pass them: setup packet
+ * to usbFunctionSetup(), data stages in 8 byte packets through
+ * usbFunctionRead() and usbFunctionWrite() */
+
+#define SESSION_STALL   (-1)
+
+/* usbPoll() is not called while a callback runs, the host drops the device
+ * if that takes longer than 50ms */
+#define SESSION_CALLBACK_LIMIT  (F_CPU/20)
+
+struct session_stats_t {
+    uint64_t longest[256];  /* cycles of the longest callback per request */
+    uint64_t longest_poll;  /* cycles of the longest gap between usbPoll() calls */
+};
+
+extern struct session_stats_t session_stats;
+
+/* start the firmware after sim_init(), clears the statistics */
+void session_init(void);
+/* the main loop starts polling usb now, restarts the measurement of the gaps
+ * between usbPoll() calls */
+void session_poll_start(void);
+
+/* device to host, returns the number of bytes received */
+int session_in(uint8_t request, uint16_t value, uint16_t index, uint8_t *data, uint16_t len);
+/* host to device, returns len */
+int session_out(uint8_t request, uint16_t value, uint16_t index, const uint8_t *data, uint16_t len);
+
+#endif
@@ -0,0 +1,678 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/delay.h>
+#include "config.h"
+#include "sim.h"
+#include "target.h"
+#include "flash25.h"
+
+/* the usart line used by updi */
+#define UART_TXD    PD1
+
+uint64_t sim_cycles;
+struct sim_stats_t sim_stats;
+
+/* replaces the value collected from uninitialized memory by random.c */
+uint16_t random_seed = 0x6b31;
+
+static volatile uint8_t regs[HOST_REGISTERS];
+static volatile uint16_t regs16[HOST_REGISTERS16];
+
+/* state of the pins at the last sync */
+static uint8_t last_portb, last_ddrb, last_portd, last_ddrd, last_ucsrb;
+
+static bool button;
+
+/* hardware spi: a byte written to SPDR is transferred on the next SPSR access */
+static struct {
+    bool pending;
+    bool spif;
+} hw;
+
+/* software spi and storage: bits are sampled on rising sck edges */
+struct shifter_t {
+    uint8_t data;
+    uint8_t bits;
+    uint64_t edge;          /* time of the last sck edge */
+    uint32_t half_period;   /* shortest phase in the current byte */
+};
+
+static struct shifter_t isp_shift, storage_shift;
+
+/* uart: bytes sent on the half duplex line are echoed, responses of the updi
+ * target follow after two idle bits, with ENABLE_UART_BRIDGE the peer gets
+ * its own line */
+#define RX_QUEUE    2048
+
+static struct {
+    bool pending;
+    bool overrun;           /* DOR until the next UDR read */
+    uint64_t line_free;     /* end of the last frame received */
+    uint64_t tx_end;        /* end of the last frame sent */
+    uint64_t low_since;     /* line driven low as gpio */
+    bool low;
+    uint8_t rx[RX_QUEUE];
+    uint64_t arrival[RX_QUEUE];
+    uint16_t head, tail;
+} uart;
+
+/* bytes sent to the peer of the bridge */
+static struct {
+    uint8_t data[RX_QUEUE];
+    uint64_t end[RX_QUEUE];
+    uint16_t head, tail;
+} peer;
+
+/* timer2 in normal mode */
+static struct {
+    uint8_t tccr;
+    uint64_t next;
+} t2;
+
+ISR(TIMER2_OVF_vect);
+ISR(USART_RXC_vect);
+ISR(USART_UDRE_vect);
+
+/* the innermost interrupt handler running */
+static void (*running)(void);
+static void sim_sync(void);
+
+static const uint16_t t2_prescaler[] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+
+/* end of the write cycle of the programmer's eeprom */
+static uint64_t eeprom_busy_until;
+
+void host_eeprom_erase(void)
+{
+    extern uint8_t __start_host_eeprom[], __stop_host_eeprom[];
+    memset(__start_host_eeprom, 0xff, __stop_host_eeprom - __start_host_eeprom);
+    eeprom_busy_until = 0;
+}
+
+bool host_eeprom_ready(void)
+{
+    sim_advance(SIM_IO_CYCLES);
+    return sim_cycles >= eeprom_busy_until;
+}
+
+void host_eeprom_wait(void)
+{
+    if (sim_cycles < eeprom_busy_until)
+        sim_advance(eeprom_busy_until - sim_cycles);
+}
+
+void host_eeprom_written(void)
+{
+    eeprom_busy_until = sim_cycles + (uint64_t)HOST_EEPROM_WRITE_US * (F_CPU/1000000);
+}
+
+void sim_init(void)
+{
+    memset((void *)regs, 0, sizeof(regs));
+    memset((void *)regs16, 0, sizeof(regs16));
+    memset(&hw, 0, sizeof(hw));
+    memset(&uart, 0, sizeof(uart));
+    memset(&peer, 0, sizeof(peer));
+    running = NULL;
+    memset(&t2, 0, sizeof(t2));
+    memset(&isp_shift, 0, sizeof(isp_shift));
+    memset(&storage_shift, 0, sizeof(storage_shift));
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    last_portb = last_ddrb = last_portd = last_ddrd = last_ucsrb = 0;
+    button = false;
+    sim_cycles = 0;
+
+    regs[HOST_UCSRA] = _BV(UDRE);
+    regs[HOST_UCSRC] = _BV(UCSZ1) | _BV(UCSZ0);
+    regs[HOST_MCUCSR] = _BV(PORF);
+
+    host_eeprom_erase();
+}
+
+void sim_button(bool pressed)
+{
+    button = pressed;
+}
+
+static bool t2_running(void)
+{
+    return t2.tccr & 7;
+}
+
+/* timer2 overflows up to the current time, overflows from while the flag
+ * was still set are lost */
+static void sim_timer2(void)
+{
+    uint8_t cs = regs[HOST_TCCR2] & 7;
+
+    if (regs[HOST_TCCR2] != t2.tccr) {
+        t2.tccr = regs[HOST_TCCR2];
+        t2.next = sim_cycles + (uint64_t)t2_prescaler[cs] * 256;
+    }
+
+    if (!t2_running())
+        return;
+
+    while (sim_cycles >= t2.next) {
+        t2.next += (uint64_t)t2_prescaler[cs] * 256;
+        regs[HOST_TIFR] |= _BV(TOV2);
+    }
+}
+
+static uint64_t uart_frame_cycles(void);
+
+static bool uart_rxc(void)
+{
+    return uart.head != uart.tail && uart.arrival[uart.tail] <= sim_cycles;
+}
+
+/* the transmitter takes the next byte while it shifts out the last one */
+static bool uart_udre(void)
+{
+    return uart.tx_end <= sim_cycles + uart_frame_cycles();
+}
+
+static bool uart_udre_running(void)
+{
+#ifdef ENABLE_UART_BRIDGE
+    return running == USART_UDRE_vect;
+#else
+    return false;
+#endif
+}
+
+/* like on the avr, the I flag is cleared while a handler runs */
+static void sim_call(void (*vector)(void))
+{
+    void (*interrupted)(void) = running;
+
+    running = vector;
+    regs[HOST_SREG] &= ~_BV(7);
+    vector();
+    sim_sync();
+    regs[HOST_SREG] |= _BV(7);
+    running = interrupted;
+}
+
+/* run the handlers of pending interrupts, in the order of their vectors */
+static void sim_interrupts(void)
+{
+    while (regs[HOST_SREG] & _BV(7)) {
+        if ((regs[HOST_TIFR] & _BV(TOV2)) && (regs[HOST_TIMSK] & _BV(TOIE2))) {
+            regs[HOST_TIFR] &= ~_BV(TOV2);
+            sim_call(TIMER2_OVF_vect);
+            continue;
+        }
+
+#ifdef ENABLE_UART_BRIDGE
+        uint8_t ucsrb = regs[HOST_UCSRB];
+        if ((ucsrb & _BV(RXCIE)) && uart_rxc()) {
+            sim_call(USART_RXC_vect);
+            continue;
+        }
+        if ((ucsrb & _BV(UDRIE)) && (ucsrb & _BV(TXEN)) && uart_udre()) {
+            sim_call(USART_UDRE_vect);
+            continue;
+        }
+#endif
+
+        break;
+    }
+}
+
+/* the next time an interrupt may become pending */
+static uint64_t sim_next_event(void)
+{
+    uint64_t next = UINT64_MAX;
+
+    if (t2_running())
+        next = t2.next;
+
+#ifdef ENABLE_UART_BRIDGE
+    uint8_t ucsrb = regs[HOST_UCSRB];
+    if (ucsrb & _BV(RXCIE)) {
+        for (uint16_t i = uart.tail; i != uart.head; i = (i + 1) % RX_QUEUE) {
+            if (uart.arrival[i] > sim_cycles) {
+                if (uart.arrival[i] < next)
+                    next = uart.arrival[i];
+                break;
+            }
+        }
+    }
+    if ((ucsrb & _BV(UDRIE)) && !uart_udre()) {
+        uint64_t udre = uart.tx_end - uart_frame_cycles();
+        if (udre < next)
+            next = udre;
+    }
+#endif
+
+    return next;
+}
+
+void sim_advance(uint64_t cycles)
+{
+    uint64_t end = sim_cycles + cycles;
+
+    /* the last register write takes effect before time passes */
+    sim_sync();
+
+    /* stop at each event, handlers run as soon as their interrupt is
+     * pending, not only at the end */
+    for (;;) {
+        uint64_t next = sim_next_event();
+        sim_cycles = next > sim_cycles && next < end ? next : end;
+        sim_timer2();
+        sim_interrupts();
+        if (sim_cycles >= end)
+            break;
+    }
+}
+
+/* sample a bit on a rising sck edge, returns true if a byte is complete */
+static bool shift_edge(struct shifter_t *s, bool rising, bool mosi)
+{
+    uint32_t phase = sim_cycles - s->edge;
+    s->edge = sim_cycles;
+
+    if (s->bits == 0 && rising)
+        s->half_period = UINT32_MAX;
+    if (s->bits > 0 || !rising)
+        if (phase < s->half_period)
+            s->half_period = phase;
+
+    if (!rising)
+        return false;
+
+    s->data = s->data << 1 | mosi;
+    if (++s->bits < 8)
+        return false;
+
+    s->bits = 0;
+    return true;
+}
+
+static void sim_isp_pins(uint8_t port, uint8_t ddr)
+{
+    uint8_t changed = (port ^ last_portb) | (ddr ^ last_ddrb);
+
+    /* reset is pulled up on the target */
+    bool reset = (port | ~ddr) & _BV(SPI_CS);
+    bool last_reset = (last_portb | ~last_ddrb) & _BV(SPI_CS);
+    if (reset != last_reset) {
+        target_reset(!reset);
+        isp_shift.bits = 0;
+    }
+
+    /* sck and mosi belong to the spi hardware while it is enabled */
+    if (regs[HOST_SPCR] & _BV(SPE))
+        return;
+
+    if (changed & _BV(SPI_SCK)) {
+        bool sck = (port & ddr) & _BV(SPI_SCK);
+        bool mosi = (port & ddr) & _BV(SPI_MOSI);
+        if (shift_edge(&isp_shift, sck, mosi)) {
+            sim_stats.spi_bytes++;
+            target_in(isp_shift.data, isp_shift.half_period);
+        }
+    }
+}
+
+static void sim_storage_pins(uint8_t port, uint8_t ddr)
+{
+    uint8_t out = port & ddr;
+    uint8_t last = last_portd & last_ddrd;
+    uint8_t changed = out ^ last;
+
+    if (changed & _BV(STORAGE_CS)) {
+        flash25_select(!(out & _BV(STORAGE_CS)));
+        storage_shift.bits = 0;
+    }
+
+    if ((changed & _BV(STORAGE_SCK)) && !(out & _BV(STORAGE_CS))) {
+        if (shift_edge(&storage_shift, out & _BV(STORAGE_SCK), out & _BV(STORAGE_MOSI))) {
+            sim_stats.storage_bytes++;
+            flash25_in(storage_shift.data);
+        }
+    }
+}
+
+static uint64_t uart_bit_cycles(void)
+{
+    uint16_t ubrr = (regs[HOST_UBRRH] & 0x0f) << 8 | regs[HOST_UBRRL];
+    return (uint64_t)(regs[HOST_UCSRA] & _BV(U2X) ? 8 : 16) * (ubrr + 1);
+}
+
+/* start, 8 data, parity and stop bits */
+static uint64_t uart_frame_cycles(void)
+{
+    uint8_t c = regs[HOST_UCSRC];
+    uint8_t bits = 1 + 8 + ((c & _BV(UPM1)) ? 1 : 0) + ((c & _BV(USBS)) ? 2 : 1);
+    return bits * uart_bit_cycles();
+}
+
+static void uart_receive(uint8_t data, uint64_t arrival)
+{
+    if (!(regs[HOST_UCSRB] & _BV(RXEN)))
+        return;
+
+    uint16_t next = (uart.head + 1) % RX_QUEUE;
+    if (next == uart.tail)
+        return;
+
+    uart.rx[uart.head] = data;
+    uart.arrival[uart.head] = arrival;
+    uart.head = next;
+}
+
+/* the receiver holds two bytes and a third one in the shift register, when
+ * the start bit of a fourth one arrives, the third is lost */
+static void uart_overrun(void)
+{
+    uint64_t frame = uart_frame_cycles();
+
+    for (;;) {
+        uint16_t third = (uart.tail + 2) % RX_QUEUE;
+        uint16_t fourth = (uart.tail + 3) % RX_QUEUE;
+
+        if ((uart.head - uart.tail + RX_QUEUE) % RX_QUEUE < 4
+                || uart.arrival[fourth] - frame > sim_cycles)
+            break;
+
+        for (uint16_t i = third; i != uart.head; i = (i + 1) % RX_QUEUE) {
+            uart.rx[i] = uart.rx[(i + 1) % RX_QUEUE];
+            uart.arrival[i] = uart.arrival[(i + 1) % RX_QUEUE];
+        }
+        uart.head = (uart.head + RX_QUEUE - 1) % RX_QUEUE;
+        uart.overrun = true;
+    }
+}
+
+#ifdef ENABLE_UART_BRIDGE
+static void sim_uart_transmit(uint8_t data)
+{
+    uint64_t start = uart.tx_end > sim_cycles ? uart.tx_end : sim_cycles;
+
+    sim_stats.uart_bytes++;
+    uart.tx_end = start + uart_frame_cycles();
+
+    uint16_t next = (peer.head + 1) % RX_QUEUE;
+    if (next == peer.tail)
+        return;
+
+    peer.data[peer.head] = data;
+    peer.end[peer.head] = uart.tx_end;
+    peer.head = next;
+}
+#else
+static void sim_uart_transmit(uint8_t data)
+{
+    static uint8_t response[256];
+    uint64_t frame = uart_frame_cycles();
+    uint64_t start = uart.line_free > sim_cycles ? uart.line_free : sim_cycles;
+
+    sim_stats.uart_bytes++;
+    uart.line_free = uart.tx_end = start + frame;
+    uart_receive(data, uart.line_free);
+
+    uint16_t len = target_updi_rx(data, response);
+    for (uint16_t i = 0; i < len; i++) {
+        uart.line_free += 2 * uart_bit_cycles() + frame;
+        uart_receive(response[i], uart.line_free);
+    }
+}
+#endif
+
+void sim_uart_send(const uint8_t *data, uint16_t len)
+{
+    uint64_t frame = uart_frame_cycles();
+
+    sim_sync();
+    for (uint16_t i = 0; i < len; i++) {
+        uint64_t start = uart.line_free > sim_cycles ? uart.line_free : sim_cycles;
+        uart.line_free = start + frame;
+        uart_receive(data[i], uart.line_free);
+    }
+}
+
+uint16_t sim_uart_receive(uint8_t *data, uint16_t len)
+{
+    uint16_t n = 0;
+
+    while (n < len && peer.tail != peer.head && peer.end[peer.tail] <= sim_cycles) {
+        data[n++] = peer.data[peer.tail];
+        peer.tail = (peer.tail + 1) % RX_QUEUE;
+    }
+
+    return n;
+}
+
+void sim_usb_interrupt(uint64_t cycles)
+{
+    uint8_t sreg = regs[HOST_SREG];
+
+    sim_sync();
+    regs[HOST_SREG] &= ~_BV(7);
+    sim_advance(cycles);
+    regs[HOST_SREG] |= sreg & _BV(7);
+    sim_advance(0);
+}
+
+static void sim_uart_line(uint8_t port, uint8_t ddr)
+{
+    /* a break is the line held low as gpio while the transmitter is off */
+    bool low = !(regs[HOST_UCSRB] & _BV(TXEN)) && (ddr & _BV(UART_TXD))
+        && !(port & _BV(UART_TXD));
+
+    if (low && !uart.low)
+        uart.low_since = sim_cycles;
+    else if (!low && uart.low && sim_cycles - uart.low_since > 2 * uart_frame_cycles())
+        target_updi_break();
+    uart.low = low;
+}
+
+/* process changes made by the last register write */
+static void sim_sync(void)
+{
+    uint8_t portb = regs[HOST_PORTB], ddrb = regs[HOST_DDRB];
+    uint8_t portd = regs[HOST_PORTD], ddrd = regs[HOST_DDRD];
+
+    if (portb != last_portb || ddrb != last_ddrb)
+        sim_isp_pins(portb, ddrb);
+    if (portd != last_portd || ddrd != last_ddrd)
+        sim_storage_pins(portd, ddrd);
+    if (portd != last_portd || ddrd != last_ddrd || regs[HOST_UCSRB] != last_ucsrb)
+        sim_uart_line(portd, ddrd);
+
+    last_portb = portb;
+    last_ddrb = ddrb;
+    last_portd = portd;
+    last_ddrd = ddrd;
+    last_ucsrb = regs[HOST_UCSRB];
+
+    if (uart.pending) {
+        uart.pending = false;
+        sim_uart_transmit(regs[HOST_UDR]);
+    }
+
+    if (!(regs[HOST_SPCR] & _BV(SPE))) {
+        hw.pending = false;
+        hw.spif = false;
+    }
+}
+
+static void sim_spi_transfer(void)
+{
+    static const uint8_t divider[] = { 4, 16, 64, 128 };
+    uint32_t cycles = divider[regs[HOST_SPCR] & 3];
+
+    if (regs[HOST_SPSR] & _BV(SPI2X))
+        cycles /= 2;
+
+    regs[HOST_SPDR] = target_transfer(regs[HOST_SPDR], cycles / 2);
+
+    sim_stats.spi_bytes++;
+    sim_stats.spi_cycles += 8 * cycles;
+    sim_advance(8 * cycles);
+
+    hw.pending = false;
+    hw.spif = true;
+}
+
+volatile uint8_t *host_reg(uint8_t reg)
+{
+    sim_sync();
+    sim_advance(SIM_IO_CYCLES);
+
+    switch (reg) {
+        case HOST_SPDR:
+            /* reading the result clears SPIF, otherwise this is a write */
+            if (hw.spif)
+                hw.spif = false;
+            else if (regs[HOST_SPCR] & _BV(SPE))
+                hw.pending = true;
+            break;
+
+        case HOST_SPSR:
+            if (hw.pending)
+                sim_spi_transfer();
+            regs[HOST_SPSR] = (regs[HOST_SPSR] & _BV(SPI2X)) | (hw.spif ? _BV(SPIF) : 0);
+            break;
+
+        case HOST_UCSRA:
+            /* skip to data arriving shortly, polling would take as long */
+            if (uart.head != uart.tail && uart.arrival[uart.tail] > sim_cycles
+                    && uart.arrival[uart.tail] - sim_cycles < 4 * uart_frame_cycles())
+                sim_advance(uart.arrival[uart.tail] - sim_cycles);
+            uart_overrun();
+            regs[HOST_UCSRA] &= ~(_BV(RXC) | _BV(FE) | _BV(DOR) | _BV(PE) | _BV(UDRE));
+            if (uart_udre())
+                regs[HOST_UCSRA] |= _BV(UDRE);
+            if (uart_rxc())
+                regs[HOST_UCSRA] |= _BV(RXC) | (uart.overrun ? _BV(DOR) : 0);
+            break;
+
+        case HOST_UDR:
+            /* an access with data received is a read, except from the data
+             * register empty handler, which may interrupt the receive handler */
+            if (uart_rxc() && !uart_udre_running()) {
+                uart_overrun();
+                regs[HOST_UDR] = uart.rx[uart.tail];
+                uart.tail = (uart.tail + 1) % RX_QUEUE;
+                uart.overrun = false;
+            } else if (regs[HOST_UCSRB] & _BV(TXEN)) {
+                uart.pending = true;
+            }
+            break;
+
+        case HOST_PINB: {
+            uint8_t port = regs[HOST_PORTB], ddr = regs[HOST_DDRB];
+            uint8_t pin = (port & ddr) | (port & ~ddr);
+
+            /* miso is driven by the target while it is in reset, and by the
+             * loader stub */
+            if (!(ddr & _BV(SPI_MISO))) {
+                pin &= ~_BV(SPI_MISO);
+                if (regs[HOST_SPCR] & _BV(SPE) ? target_miso()
+                        : isp_shift.bits > 7 || (target_out() << isp_shift.bits) & 0x80)
+                    pin |= _BV(SPI_MISO);
+            }
+            if (button)
+                pin &= ~_BV(BUTTON_PIN);
+            regs[HOST_PINB] = pin;
+            break;
+        }
+
+        case HOST_PINC:
+            regs[HOST_PINC] = regs[HOST_PORTC];
+            break;
+
+        case HOST_PIND: {
+            uint8_t port = regs[HOST_PORTD], ddr = regs[HOST_DDRD];
+            uint8_t pin = (port & ddr) | (port & ~ddr);
+
+            if (!(ddr & _BV(STORAGE_MISO)) && flash25_fitted) {
+                pin &= ~_BV(STORAGE_MISO);
+                if ((flash25_out() << storage_shift.bits) & 0x80)
+                    pin |= _BV(STORAGE_MISO);
+            }
+            regs[HOST_PIND] = pin;
+            break;
+        }
+
+        case HOST_TCNT2: {
+            uint8_t cs = regs[HOST_TCCR2] & 7;
+            if (cs) {
+                uint32_t period = (uint32_t)t2_prescaler[cs] * 256;
+                uint64_t left = t2.next > sim_cycles ? t2.next - sim_cycles : 0;
+                regs[HOST_TCNT2] = (period - left) / t2_prescaler[cs];
+            }
+            break;
+        }
+    }
+
+    return &regs[reg];
+}
+
+volatile uint16_t *host_reg16(uint8_t reg)
+{
+    sim_sync();
+    sim_advance(SIM_IO_CYCLES);
+
+    return &regs16[reg];
+}
+
+static void sim_delay(uint64_t cycles)
+{
+    sim_sync();
+    sim_stats.delay_cycles += cycles;
+    sim_advance(cycles);
+}
+
+void _delay_loop_1(uint8_t count)
+{
+    sim_delay(3 * (count ? count : 256));
+}
+
+void _delay_loop_2(uint16_t count)
+{
+    sim_delay(4 * (count ? count : 65536UL));
+}
+
+void _delay_us(double us)
+{
+    sim_delay(us * (F_CPU/1000000));
+}
+
+void _delay_ms(double ms)
+{
+    sim_delay(ms * (F_CPU/1000));
+}
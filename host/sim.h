@@ -0,0 +1,73 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __HOST_SIM_H
+#define __HOST_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+
+/* simulation of the programmer's ports, spi, uart and timer2 for the host
+ * build: register accesses and delay loops advance the simulated time, the
+ * isp target (target.h), the storage flash (flash25.h) and an updi target
+ * are connected to the pins */
+
+/* rough cost of a register access including the code around it, the
+ * firmware's own instructions are not simulated otherwise */
+#define SIM_IO_CYCLES   2
+
+/* simulated time in cycles of the programmer (F_CPU) */
+extern uint64_t sim_cycles;
+
+struct sim_stats_t {
+    uint64_t delay_cycles;  /* spent in _delay_loop_*() */
+    uint64_t spi_cycles;    /* spent waiting for hardware spi transfers */
+    uint32_t spi_bytes;     /* bytes clocked on the isp pins */
+    uint32_t storage_bytes;
+    uint32_t uart_bytes;    /* bytes sent on the uart */
+};
+
+extern struct sim_stats_t sim_stats;
+
+/* power up: registers, eeprom and time are cleared, the devices are not */
+void sim_init(void);
+void sim_advance(uint64_t cycles);
+/* start button (BUTTON_PIN) */
+void sim_button(bool pressed);
+
+/* the other end of the uart bridge (ENABLE_UART_BRIDGE): sim_uart_send()
+ * queues bytes sent back to back after those already queued,
+ * sim_uart_receive() returns the bytes the programmer has sent so far */
+void sim_uart_send(const uint8_t *data, uint16_t len);
+uint16_t sim_uart_receive(uint8_t *data, uint16_t len);
+
+/* the usb interrupt handling a packet, other interrupts have to wait */
+void sim_usb_interrupt(uint64_t cycles);
+
+/* time in us */
+#define SIM_US(cycles)  ((cycles) / (F_CPU/1000000))
+
+#endif
@@ -0,0 +1,122 @@
+/* generated from stubs/loader.S, do not edit: `make stub_images.h`, then copy
+ * it here.  the host build uses this copy, it does not need an avr toolchain */
+static const uint8_t stub_atmega8[] PROGMEM = {
+0x09,0xc0,0x83,0xe0,0x87,0xbf,0xe8,0x95,0x87,0xb7,0x80,0xfd,0xfd,0xcf,0xe0,0x54,
+0xf0,0x40,0xf7,0xcf,0xf8,0x94,0x8f,0xe5,0x8d,0xbf,0x84,0xe0,0x8e,0xbf,0xc4,0x98,
+0xbc,0x9a,0xa0,0xee,0xb3,0xe0,0x30,0xe4,0x85,0xea,0x98,0xe0,0x42,0xd0,0xc4,0x98,
+0x26,0x2f,0x50,0xd0,0xf8,0x2f,0x4e,0xd0,0xe8,0x2f,0x20,0x35,0x29,0xf0,0x28,0x35,
+0x01,0xf3,0x23,0x34,0xc1,0xf0,0xed,0xcf,0x45,0xd0,0x8d,0x93,0x3a,0x95,0xe1,0xf7,
+0xa0,0x54,0xb0,0x40,0x30,0xe2,0x0d,0x90,0x1d,0x90,0x81,0xe0,0x24,0xd0,0x32,0x96,
+0x3a,0x95,0xc9,0xf7,0xe0,0x54,0xf0,0x40,0x83,0xe0,0x1d,0xd0,0x85,0xe0,0x1b,0xd0,
+0x81,0xe1,0x19,0xd0,0xd6,0xcf,0xdf,0x01,0xee,0x27,0xff,0x27,0x6f,0xef,0x7f,0xef,
+0x41,0xe0,0x50,0xea,0x85,0x91,0x68,0x27,0x98,0xe0,0x76,0x95,0x67,0x95,0x10,0xf4,
+0x64,0x27,0x75,0x27,0x9a,0x95,0xc9,0xf7,0xea,0x17,0xfb,0x07,0x99,0xf7,0x85,0xea,
+0x98,0xe1,0x07,0xd0,0xbe,0xcf,0x97,0xb7,0x90,0xfd,0xfd,0xcf,0x87,0xbf,0xe8,0x95,
+0x08,0x95,0x18,0xb3,0x87,0xfb,0x14,0xf9,0x18,0xbb,0xb5,0x9b,0xfe,0xcf,0x88,0x94,
+0xb3,0x99,0x08,0x94,0x66,0x1f,0x77,0x1f,0x88,0x1f,0x9a,0x95,0xb5,0x99,0xfe,0xcf,
+0x89,0xf7,0x08,0x95,0x98,0xe0,0xb5,0x9b,0xfe,0xcf,0x88,0x0f,0xb3,0x99,0x81,0x60,
+0xb5,0x99,0xfe,0xcf,0x9a,0x95,0xb9,0xf7,0x08,0x95,0x40,0x00,
+};
+static const uint8_t stub_atmega88[] PROGMEM = {
+0x09,0xc0,0x83,0xe0,0x87,0xbf,0xe8,0x95,0x87,0xb7,0x80,0xfd,0xfd,0xcf,0xe0,0x54,
+0xf0,0x40,0xf7,0xcf,0xf8,0x94,0x8f,0xef,0x8d,0xbf,0x84,0xe0,0x8e,0xbf,0x2c,0x98,
+0x24,0x9a,0xa0,0xe8,0xb4,0xe0,0x30,0xe4,0x85,0xea,0x98,0xe0,0x42,0xd0,0x2c,0x98,
+0x26,0x2f,0x50,0xd0,0xf8,0x2f,0x4e,0xd0,0xe8,0x2f,0x20,0x35,0x29,0xf0,0x28,0x35,
+0x01,0xf3,0x23,0x34,0xc1,0xf0,0xed,0xcf,0x45,0xd0,0x8d,0x93,0x3a,0x95,0xe1,0xf7,
+0xa0,0x54,0xb0,0x40,0x30,0xe2,0x0d,0x90,0x1d,0x90,0x81,0xe0,0x24,0xd0,0x32,0x96,
+0x3a,0x95,0xc9,0xf7,0xe0,0x54,0xf0,0x40,0x83,0xe0,0x1d,0xd0,0x85,0xe0,0x1b,0xd0,
+0x81,0xe1,0x19,0xd0,0xd6,0xcf,0xdf,0x01,0xee,0x27,0xff,0x27,0x6f,0xef,0x7f,0xef,
+0x41,0xe0,0x50,0xea,0x85,0x91,0x68,0x27,0x98,0xe0,0x76,0x95,0x67,0x95,0x10,0xf4,
+0x64,0x27,0x75,0x27,0x9a,0x95,0xc9,0xf7,0xea,0x17,0xfb,0x07,0x99,0xf7,0x85,0xea,
+0x98,0xe1,0x07,0xd0,0xbe,0xcf,0x97,0xb7,0x90,0xfd,0xfd,0xcf,0x87,0xbf,0xe8,0x95,
+0x08,0x95,0x15,0xb1,0x87,0xfb,0x14,0xf9,0x15,0xb9,0x1d,0x9b,0xfe,0xcf,0x88,0x94,
+0x1b,0x99,0x08,0x94,0x66,0x1f,0x77,0x1f,0x88,0x1f,0x9a,0x95,0x1d,0x99,0xfe,0xcf,
+0x89,0xf7,0x08,0x95,0x98,0xe0,0x1d,0x9b,0xfe,0xcf,0x88,0x0f,0x1b,0x99,0x81,0x60,
+0x1d,0x99,0xfe,0xcf,0x9a,0x95,0xb9,0xf7,0x08,0x95,0x40,0x00,
+};
+static const uint8_t stub_atmega168[] PROGMEM = {
+0x09,0xc0,0x83,0xe0,0x87,0xbf,0xe8,0x95,0x87,0xb7,0x80,0xfd,0xfd,0xcf,0xe0,0x58,
+0xf0,0x40,0xf7,0xcf,0xf8,0x94,0x8f,0xef,0x8d,0xbf,0x84,0xe0,0x8e,0xbf,0x2c,0x98,
+0x24,0x9a,0xa0,0xe0,0xb4,0xe0,0x30,0xe8,0x85,0xea,0x98,0xe0,0x42,0xd0,0x2c,0x98,
+0x26,0x2f,0x50,0xd0,0xf8,0x2f,0x4e,0xd0,0xe8,0x2f,0x20,0x35,0x29,0xf0,0x28,0x35,
+0x01,0xf3,0x23,0x34,0xc1,0xf0,0xed,0xcf,0x45,0xd0,0x8d,0x93,0x3a,0x95,0xe1,0xf7,
+0xa0,0x58,0xb0,0x40,0x30,0xe4,0x0d,0x90,0x1d,0x90,0x81,0xe0,0x24,0xd0,0x32,0x96,
+0x3a,0x95,0xc9,0xf7,0xe0,0x58,0xf0,0x40,0x83,0xe0,0x1d,0xd0,0x85,0xe0,0x1b,0xd0,
+0x81,0xe1,0x19,0xd0,0xd6,0xcf,0xdf,0x01,0xee,0x27,0xff,0x27,0x6f,0xef,0x7f,0xef,
+0x41,0xe0,0x50,0xea,0x85,0x91,0x68,0x27,0x98,0xe0,0x76,0x95,0x67,0x95,0x10,0xf4,
+0x64,0x27,0x75,0x27,0x9a,0x95,0xc9,0xf7,0xea,0x17,0xfb,0x07,0x99,0xf7,0x85,0xea,
+0x98,0xe1,0x07,0xd0,0xbe,0xcf,0x97,0xb7,0x90,0xfd,0xfd,0xcf,0x87,0xbf,0xe8,0x95,
+0x08,0x95,0x15,0xb1,0x87,0xfb,0x14,0xf9,0x15,0xb9,0x1d,0x9b,0xfe,0xcf,0x88,0x94,
+0x1b,0x99,0x08,0x94,0x66,0x1f,0x77,0x1f,0x88,0x1f,0x9a,0x95,0x1d,0x99,0xfe,0xcf,
+0x89,0xf7,0x08,0x95,0x98,0xe0,0x1d,0x9b,0xfe,0xcf,0x88,0x0f,0x1b,0x99,0x81,0x60,
+0x1d,0x99,0xfe,0xcf,0x9a,0x95,0xb9,0xf7,0x08,0x95,0x80,0x00,
+};
+static const uint8_t stub_atmega328p[] PROGMEM = {
+0x09,0xc0,0x83,0xe0,0x87,0xbf,0xe8,0x95,0x87,0xb7,0x80,0xfd,0xfd,0xcf,0xe0,0x58,
+0xf0,0x40,0xf7,0xcf,0xf8,0x94,0x8f,0xef,0x8d,0xbf,0x88,0xe0,0x8e,0xbf,0x2c,0x98,
+0x24,0x9a,0xa0,0xe0,0xb8,0xe0,0x30,0xe8,0x85,0xea,0x98,0xe0,0x42,0xd0,0x2c,0x98,
+0x26,0x2f,0x50,0xd0,0xf8,0x2f,0x4e,0xd0,0xe8,0x2f,0x20,0x35,0x29,0xf0,0x28,0x35,
+0x01,0xf3,0x23,0x34,0xc1,0xf0,0xed,0xcf,0x45,0xd0,0x8d,0x93,0x3a,0x95,0xe1,0xf7,
+0xa0,0x58,0xb0,0x40,0x30,0xe4,0x0d,0x90,0x1d,0x90,0x81,0xe0,0x24,0xd0,0x32,0x96,
+0x3a,0x95,0xc9,0xf7,0xe0,0x58,0xf0,0x40,0x83,0xe0,0x1d,0xd0,0x85,0xe0,0x1b,0xd0,
+0x81,0xe1,0x19,0xd0,0xd6,0xcf,0xdf,0x01,0xee,0x27,0xff,0x27,0x6f,0xef,0x7f,0xef,
+0x41,0xe0,0x50,0xea,0x85,0x91,0x68,0x27,0x98,0xe0,0x76,0x95,0x67,0x95,0x10,0xf4,
+0x64,0x27,0x75,0x27,0x9a,0x95,0xc9,0xf7,0xea,0x17,0xfb,0x07,0x99,0xf7,0x85,0xea,
+0x98,0xe1,0x07,0xd0,0xbe,0xcf,0x97,0xb7,0x90,0xfd,0xfd,0xcf,0x87,0xbf,0xe8,0x95,
+0x08,0x95,0x15,0xb1,0x87,0xfb,0x14,0xf9,0x15,0xb9,0x1d,0x9b,0xfe,0xcf,0x88,0x94,
+0x1b,0x99,0x08,0x94,0x66,0x1f,0x77,0x1f,0x88,0x1f,0x9a,0x95,0x1d,0x99,0xfe,0xcf,
+0x89,0xf7,0x08,0x95,0x98,0xe0,0x1d,0x9b,0xfe,0xcf,0x88,0x0f,0x1b,0x99,0x81,0x60,
+0x1d,0x99,0xfe,0xcf,0x9a,0x95,0xb9,0xf7,0x08,0x95,0x80,0x00,
+};
+static const uint8_t stub_atmega16[] PROGMEM = {
+0x09,0xc0,0x83,0xe0,0x87,0xbf,0xe8,0x95,0x87,0xb7,0x80,0xfd,0xfd,0xcf,0xe0,0x58,
+0xf0,0x40,0xf7,0xcf,0xf8,0x94,0x8f,0xe5,0x8d,0xbf,0x84,0xe0,0x8e,0xbf,0xc6,0x98,
+0xbe,0x9a,0xa0,0xe6,0xb3,0xe0,0x30,0xe8,0x85,0xea,0x98,0xe0,0x42,0xd0,0xc6,0x98,
+0x26,0x2f,0x50,0xd0,0xf8,0x2f,0x4e,0xd0,0xe8,0x2f,0x20,0x35,0x29,0xf0,0x28,0x35,
+0x01,0xf3,0x23,0x34,0xc1,0xf0,0xed,0xcf,0x45,0xd0,0x8d,0x93,0x3a,0x95,0xe1,0xf7,
+0xa0,0x58,0xb0,0x40,0x30,0xe4,0x0d,0x90,0x1d,0x90,0x81,0xe0,0x24,0xd0,0x32,0x96,
+0x3a,0x95,0xc9,0xf7,0xe0,0x58,0xf0,0x40,0x83,0xe0,0x1d,0xd0,0x85,0xe0,0x1b,0xd0,
+0x81,0xe1,0x19,0xd0,0xd6,0xcf,0xdf,0x01,0xee,0x27,0xff,0x27,0x6f,0xef,0x7f,0xef,
+0x41,0xe0,0x50,0xea,0x85,0x91,0x68,0x27,0x98,0xe0,0x76,0x95,0x67,0x95,0x10,0xf4,
+0x64,0x27,0x75,0x27,0x9a,0x95,0xc9,0xf7,0xea,0x17,0xfb,0x07,0x99,0xf7,0x85,0xea,
+0x98,0xe1,0x07,0xd0,0xbe,0xcf,0x97,0xb7,0x90,0xfd,0xfd,0xcf,0x87,0xbf,0xe8,0x95,
+0x08,0x95,0x18,0xb3,0x87,0xfb,0x16,0xf9,0x18,0xbb,0xb7,0x9b,0xfe,0xcf,0x88,0x94,
+0xb5,0x99,0x08,0x94,0x66,0x1f,0x77,0x1f,0x88,0x1f,0x9a,0x95,0xb7,0x99,0xfe,0xcf,
+0x89,0xf7,0x08,0x95,0x98,0xe0,0xb7,0x9b,0xfe,0xcf,0x88,0x0f,0xb5,0x99,0x81,0x60,
+0xb7,0x99,0xfe,0xcf,0x9a,0x95,0xb9,0xf7,0x08,0x95,0x80,0x00,
+};
+static const uint8_t stub_atmega32[] PROGMEM = {
+0x09,0xc0,0x83,0xe0,0x87,0xbf,0xe8,0x95,0x87,0xb7,0x80,0xfd,0xfd,0xcf,0xe0,0x58,
+0xf0,0x40,0xf7,0xcf,0xf8,0x94,0x8f,0xe5,0x8d,0xbf,0x88,0xe0,0x8e,0xbf,0xc6,0x98,
+0xbe,0x9a,0xa0,0xe6,0xb7,0xe0,0x30,0xe8,0x85,0xea,0x98,0xe0,0x42,0xd0,0xc6,0x98,
+0x26,0x2f,0x50,0xd0,0xf8,0x2f,0x4e,0xd0,0xe8,0x2f,0x20,0x35,0x29,0xf0,0x28,0x35,
+0x01,0xf3,0x23,0x34,0xc1,0xf0,0xed,0xcf,0x45,0xd0,0x8d,0x93,0x3a,0x95,0xe1,0xf7,
+0xa0,0x58,0xb0,0x40,0x30,0xe4,0x0d,0x90,0x1d,0x90,0x81,0xe0,0x24,0xd0,0x32,0x96,
+0x3a,0x95,0xc9,0xf7,0xe0,0x58,0xf0,0x40,0x83,0xe0,0x1d,0xd0,0x85,0xe0,0x1b,0xd0,
+0x81,0xe1,0x19,0xd0,0xd6,0xcf,0xdf,0x01,0xee,0x27,0xff,0x27,0x6f,0xef,0x7f,0xef,
+0x41,0xe0,0x50,0xea,0x85,0x91,0x68,0x27,0x98,0xe0,0x76,0x95,0x67,0x95,0x10,0xf4,
+0x64,0x27,0x75,0x27,0x9a,0x95,0xc9,0xf7,0xea,0x17,0xfb,0x07,0x99,0xf7,0x85,0xea,
+0x98,0xe1,0x07,0xd0,0xbe,0xcf,0x97,0xb7,0x90,0xfd,0xfd,0xcf,0x87,0xbf,0xe8,0x95,
+0x08,0x95,0x18,0xb3,0x87,0xfb,0x16,0xf9,0x18,0xbb,0xb7,0x9b,0xfe,0xcf,0x88,0x94,
+0xb5,0x99,0x08,0x94,0x66,0x1f,0x77,0x1f,0x88,0x1f,0x9a,0x95,0xb7,0x99,0xfe,0xcf,
+0x89,0xf7,0x08,0x95,0x98,0xe0,0xb7,0x9b,0xfe,0xcf,0x88,0x0f,0xb5,0x99,0x81,0x60,
+0xb7,0x99,0xfe,0xcf,0x9a,0x95,0xb9,0xf7,0x08,0x95,0x80,0x00,
+};
+static const uint8_t stub_atmega644p[] PROGMEM = {
+0x09,0xc0,0x83,0xe0,0x87,0xbf,0xe8,0x95,0x87,0xb7,0x80,0xfd,0xfd,0xcf,0xe0,0x50,
+0xf1,0x40,0xf7,0xcf,0xf8,0x94,0x8f,0xef,0x8d,0xbf,0x80,0xe1,0x8e,0xbf,0x2e,0x98,
+0x26,0x9a,0xa0,0xe0,0xbf,0xe0,0x30,0xe0,0x85,0xea,0x98,0xe0,0x42,0xd0,0x2e,0x98,
+0x26,0x2f,0x50,0xd0,0xf8,0x2f,0x4e,0xd0,0xe8,0x2f,0x20,0x35,0x29,0xf0,0x28,0x35,
+0x01,0xf3,0x23,0x34,0xc1,0xf0,0xed,0xcf,0x45,0xd0,0x8d,0x93,0x3a,0x95,0xe1,0xf7,
+0xa0,0x50,0xb1,0x40,0x30,0xe8,0x0d,0x90,0x1d,0x90,0x81,0xe0,0x24,0xd0,0x32,0x96,
+0x3a,0x95,0xc9,0xf7,0xe0,0x50,0xf1,0x40,0x83,0xe0,0x1d,0xd0,0x85,0xe0,0x1b,0xd0,
+0x81,0xe1,0x19,0xd0,0xd6,0xcf,0xdf,0x01,0xee,0x27,0xff,0x27,0x6f,0xef,0x7f,0xef,
+0x41,0xe0,0x50,0xea,0x85,0x91,0x68,0x27,0x98,0xe0,0x76,0x95,0x67,0x95,0x10,0xf4,
+0x64,0x27,0x75,0x27,0x9a,0x95,0xc9,0xf7,0xea,0x17,0xfb,0x07,0x99,0xf7,0x85,0xea,
+0x98,0xe1,0x07,0xd0,0xbe,0xcf,0x97,0xb7,0x90,0xfd,0xfd,0xcf,0x87,0xbf,0xe8,0x95,
+0x08,0x95,0x15,0xb1,0x87,0xfb,0x16,0xf9,0x15,0xb9,0x1f,0x9b,0xfe,0xcf,0x88,0x94,
+0x1d,0x99,0x08,0x94,0x66,0x1f,0x77,0x1f,0x88,0x1f,0x9a,0x95,0x1f,0x99,0xfe,0xcf,
+0x89,0xf7,0x08,0x95,0x98,0xe0,0x1f,0x9b,0xfe,0xcf,0x88,0x0f,0x1d,0x99,0x81,0x60,
+0x1f,0x99,0xfe,0xcf,0x9a,0x95,0xb9,0xf7,0x08,0x95,0x00,0x01,
+};
+#define STUB_IMAGES STUB_IMAGE(stub_atmega8) STUB_IMAGE(stub_atmega88) STUB_IMAGE(stub_atmega168) STUB_IMAGE(stub_atmega328p) STUB_IMAGE(stub_atmega16) STUB_IMAGE(stub_atmega32) STUB_IMAGE(stub_atmega644p)
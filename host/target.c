@@ -0,0 +1,469 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "cpu.h"
+
+const struct target_device_t target_atmega8 = {
+    .name = "atmega8",
+    .signature = { 0x1e, 0x93, 0x07 },
+    .flash_size = 8*1024,
+    .flash_pagesize = 64,
+    .eeprom_size = 512,
+    .flash_write = 4500,
+    .eeprom_write = 9000,
+    .chip_erase = 9000,
+    .fuse_write = 4500,
+    .fuses = { 0xe1, 0xd9, 0xff, 0xff },
+    .boot_min = 256,
+    .stub_image = 0,
+    .pinb = 0x16,
+};
+
+const struct target_device_t target_atmega328p = {
+    .name = "atmega328p",
+    .signature = { 0x1e, 0x95, 0x0f },
+    .flash_size = 32*1024,
+    .flash_pagesize = 128,
+    .eeprom_size = 1024,
+    .flash_write = 2600,
+    .eeprom_write = 3600,
+    .chip_erase = 10500,
+    .fuse_write = 4500,
+    .fuses = { 0x62, 0xd9, 0xff, 0xff },
+    .boot_min = 512,
+    .stub_image = 3,
+    .pinb = 0x03,
+};
+
+struct target_stats_t target_stats;
+uint8_t target_flash[TARGET_FLASH_MAX];
+uint8_t target_eeprom[TARGET_EEPROM_MAX];
+uint8_t target_fuses[4];
+
+/* busy with */
+#define BUSY_NONE   0
+#define BUSY_FLASH  1
+#define BUSY_EEPROM 2
+#define BUSY_FUSES  3
+
+static struct {
+    const struct target_device_t *device;
+    uint32_t clock;
+
+    bool reset;
+    bool enabled;       /* programming enable received while in reset */
+    uint8_t frame[4];
+    uint8_t pos;
+    uint8_t out;
+
+    uint8_t busy;
+    uint64_t busy_until;
+    bool waiting;       /* no instruction since the end of the write cycle */
+    uint64_t wait_since;
+
+    uint8_t page[256];
+} target;
+
+void target_init(const struct target_device_t *device, uint32_t clock)
+{
+    cpu_stop();
+    memset(&target, 0, sizeof(target));
+    memset(&target_stats, 0, sizeof(target_stats));
+    target.device = device;
+    target.clock = clock;
+    target.out = 0xff;
+
+    memset(target_flash, 0xff, sizeof(target_flash));
+    memset(target_eeprom, 0xff, sizeof(target_eeprom));
+    memset(target.page, 0xff, sizeof(target.page));
+    memcpy(target_fuses, device->fuses, sizeof(target_fuses));
+}
+
+/* the programmer is done waiting for the last write cycle */
+static void target_wait_done(void)
+{
+    if (target.waiting) {
+        target_stats.wait_cycles += sim_cycles - target.wait_since;
+        target.waiting = false;
+    }
+}
+
+void target_reset(bool active)
+{
+    target_wait_done();
+
+    if (cpu_running() && !cpu_stop())
+        target_stats.violations++;
+
+    /* BOOTRST is bit 0 of the high fuse, BOOTSZ bits 2:1 */
+    if (!active && !(target_fuses[1] & 1)) {
+        uint16_t boot = target.device->boot_min << (3 - ((target_fuses[1] >> 1) & 3));
+        cpu_start(target.device, target.clock, target.device->flash_size - boot);
+    }
+
+    target.reset = active;
+    target.enabled = false;
+    target.pos = 0;
+    target.out = active ? 0 : 0xff;
+}
+
+uint8_t target_out(void)
+{
+    return target.out;
+}
+
+bool target_miso(void)
+{
+    return cpu_running() ? cpu_miso() : true;
+}
+
+static bool target_busy(void)
+{
+    if (target.busy && sim_cycles >= target.busy_until)
+        target.busy = BUSY_NONE;
+
+    return target.busy != BUSY_NONE;
+}
+
+static void target_start(uint8_t busy, uint16_t us)
+{
+    target.busy = busy;
+    target.busy_until = sim_cycles + (uint64_t)us * (F_CPU/1000000);
+    target.waiting = true;
+    target.wait_since = sim_cycles;
+}
+
+/* result of a read instruction, sent during the fourth byte */
+static uint8_t target_read(const uint8_t *f)
+{
+    const struct target_device_t *dev = target.device;
+    uint16_t address = f[1] << 8 | f[2];
+
+    switch (f[0]) {
+        case 0x20:
+        case 0x28:
+            if (target_busy()) {
+                target_stats.busy_polls++;
+                return 0xff;
+            }
+            return target_flash[((uint32_t)address*2 + (f[0] == 0x28)) % dev->flash_size];
+        case 0xa0:
+            if (target_busy()) {
+                target_stats.busy_polls++;
+                return 0xff;
+            }
+            return target_eeprom[address % dev->eeprom_size];
+        case 0xf0:
+            if (target_busy()) {
+                target_stats.busy_polls++;
+                return 1;
+            }
+            return 0;
+        case 0x30:
+            return f[2] < 3 ? dev->signature[f[2]] : 0;
+        case 0x50:
+            return target_fuses[f[1] == 0x08 ? 2 : 0];
+        case 0x58:
+            return target_fuses[f[1] == 0x08 ? 1 : 3];
+        case 0x38:
+            return 0xa5;
+    }
+
+    return f[2];
+}
+
+/* execute a write instruction after the fourth byte */
+static void target_write(const uint8_t *f)
+{
+    const struct target_device_t *dev = target.device;
+    uint16_t address = f[1] << 8 | f[2];
+    uint16_t words = dev->flash_pagesize / 2;
+
+    switch (f[0]) {
+        case 0x20: case 0x28: case 0xa0: case 0xf0:
+        case 0x30: case 0x50: case 0x58: case 0x38:
+            return;
+    }
+
+    if (target_busy()) {
+        target_stats.violations++;
+        return;
+    }
+
+    switch (f[0]) {
+        case 0x40:
+        case 0x48:
+            target.page[(f[2] & (words-1))*2 + (f[0] == 0x48)] = f[3];
+            return;
+        case 0x4c: {
+            /* flash is not erased by a page write, bits can only be cleared */
+            uint32_t base = ((uint32_t)(address & ~(words-1)) * 2) % dev->flash_size;
+            for (uint16_t i = 0; i < dev->flash_pagesize; i++)
+                target_flash[base + i] &= target.page[i];
+            memset(target.page, 0xff, sizeof(target.page));
+            target_stats.page_writes++;
+            target_start(BUSY_FLASH, dev->flash_write);
+            return;
+        }
+        case 0xc0:
+            target_eeprom[address % dev->eeprom_size] = f[3];
+            target_stats.eeprom_writes++;
+            target_start(BUSY_EEPROM, dev->eeprom_write);
+            return;
+        case 0xac:
+            switch (f[1]) {
+                case 0x53:
+                    /* programming enable */
+                    return;
+                case 0x80:
+                    memset(target_flash, 0xff, dev->flash_size);
+                    /* EESAVE is bit 3 of the high fuse */
+                    if (target_fuses[1] & _BV(3))
+                        memset(target_eeprom, 0xff, dev->eeprom_size);
+                    target_start(BUSY_FLASH, dev->chip_erase);
+                    return;
+                case 0xa0:
+                    target_fuses[0] = f[3];
+                    break;
+                case 0xa8:
+                    target_fuses[1] = f[3];
+                    break;
+                case 0xa4:
+                    target_fuses[2] = f[3];
+                    break;
+                case 0xe0:
+                    target_fuses[3] &= f[3];
+                    break;
+                default:
+                    target_stats.violations++;
+                    return;
+            }
+            target_start(BUSY_FUSES, dev->fuse_write);
+            return;
+    }
+
+    target_stats.violations++;
+}
+
+void target_in(uint8_t data, uint32_t half_period)
+{
+    if (!target.reset)
+        return;
+
+    /* sck high and low must each last more than 2 target clock cycles (3 at
+     * 12MHz and above), otherwise bits are lost */
+    uint32_t min = target.clock >= 12000000 ? 3 : 2;
+    if ((uint64_t)half_period * target.clock <= (uint64_t)min * F_CPU) {
+        target_stats.garbled++;
+        data >>= 1;
+    }
+
+    uint8_t *f = target.frame;
+    f[target.pos] = data;
+
+    if (!target.enabled) {
+        /* only programming enable is understood, 0x53 is echoed if in sync */
+        target.out = 0;
+        if (target.pos == 1 && f[0] == 0xac && f[1] == 0x53) {
+            target.enabled = true;
+            target.out = 0x53;
+        }
+        target.pos = (target.pos + 1) & 3;
+        return;
+    }
+
+    if (target.pos == 0 && !target_busy())
+        target_wait_done();
+
+    switch (target.pos++) {
+        case 0:
+        case 1:
+            /* echo the previous byte */
+            target.out = data;
+            break;
+        case 2:
+            target.out = target_read(f);
+            break;
+        default:
+            target_write(f);
+            target_stats.instructions++;
+            target.out = 0;
+            target.pos = 0;
+            break;
+    }
+}
+
+uint8_t target_transfer(uint8_t data, uint32_t half_period)
+{
+    if (cpu_running())
+        return cpu_transfer(data, half_period);
+
+    uint8_t out = target.out;
+    target_in(data, half_period);
+    return out;
+}
+
+/* updi target */
+
+uint8_t target_updi_memory[0x10000];
+
+#define UPDI_IDLE       0
+#define UPDI_OPCODE     1
+#define UPDI_STCS       2
+#define UPDI_REPEAT     3
+#define UPDI_ADDRESS    4
+#define UPDI_STORE      5
+
+static struct {
+    uint8_t state;
+    uint8_t opcode;
+    uint8_t cs[16];
+    uint16_t pointer;
+    uint16_t address;
+    uint8_t address_bytes;
+    uint16_t repeat;
+} updi;
+
+void target_updi_init(const uint8_t signature[3])
+{
+    memset(&updi, 0, sizeof(updi));
+    memset(target_updi_memory, 0xff, sizeof(target_updi_memory));
+    memcpy(&target_updi_memory[TARGET_UPDI_SIGNATURE], signature, 3);
+    /* updi revision 3 in STATUSA */
+    updi.cs[0] = 0x30;
+}
+
+void target_updi_break(void)
+{
+    updi.state = UPDI_IDLE;
+    updi.repeat = 0;
+}
+
+/* response signature disabled */
+static bool updi_rsd(void)
+{
+    return updi.cs[2] & _BV(3);
+}
+
+static uint8_t updi_ack(uint8_t *data)
+{
+    if (updi_rsd())
+        return 0;
+
+    data[0] = 0x40;
+    return 1;
+}
+
+uint16_t target_updi_rx(uint8_t byte, uint8_t *data)
+{
+    uint16_t len = 0;
+
+    switch (updi.state) {
+        case UPDI_IDLE:
+            if (byte == 0x55)
+                updi.state = UPDI_OPCODE;
+            return 0;
+
+        case UPDI_OPCODE:
+            updi.opcode = byte;
+            updi.state = UPDI_IDLE;
+
+            if ((byte & 0xf0) == 0x80) {
+                /* LDCS */
+                data[0] = updi.cs[byte & 0x0f];
+                return 1;
+            } else if ((byte & 0xf0) == 0xc0) {
+                updi.state = UPDI_STCS;
+            } else if (byte == 0xa0) {
+                updi.state = UPDI_REPEAT;
+            } else if (byte == 0x69 || byte == 0x04 || byte == 0x44) {
+                /* ST ptr, LDS, STS with 16 bit address */
+                updi.state = UPDI_ADDRESS;
+                updi.address_bytes = 0;
+            } else if (byte == 0x24) {
+                /* LD *ptr++ */
+                do {
+                    data[len++] = target_updi_memory[updi.pointer++];
+                } while (updi.repeat && updi.repeat-- > 1);
+                updi.repeat = 0;
+                return len;
+            } else if (byte == 0x64) {
+                /* ST *ptr++ */
+                updi.state = UPDI_STORE;
+            }
+            return 0;
+
+        case UPDI_STCS:
+            updi.cs[updi.opcode & 0x0f] = byte;
+            updi.state = UPDI_IDLE;
+            return 0;
+
+        case UPDI_REPEAT:
+            updi.repeat = byte + 1;
+            updi.state = UPDI_IDLE;
+            return 0;
+
+        case UPDI_ADDRESS:
+            if (updi.address_bytes++ == 0) {
+                updi.address = byte;
+                return 0;
+            }
+            updi.address |= byte << 8;
+
+            if (updi.opcode == 0x69) {
+                updi.pointer = updi.address;
+                updi.state = UPDI_IDLE;
+                return updi_ack(data);
+            }
+            if (updi.opcode == 0x04) {
+                updi.state = UPDI_IDLE;
+                data[0] = target_updi_memory[updi.address];
+                return 1;
+            }
+            /* STS: address acknowledged, then the data byte */
+            updi.pointer = updi.address;
+            updi.repeat = 1;
+            updi.opcode = 0x64;
+            updi.state = UPDI_STORE;
+            return updi_ack(data);
+
+        case UPDI_STORE:
+            target_updi_memory[updi.pointer++] = byte;
+            if (updi.repeat <= 1) {
+                updi.repeat = 0;
+                updi.state = UPDI_IDLE;
+            } else {
+                updi.repeat--;
+            }
+            return updi_ack(data);
+    }
+
+    return 0;
+}
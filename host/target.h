@@ -0,0 +1,112 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __HOST_TARGET_H
+#define __HOST_TARGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* simulated avr on the isp pins: serial programming instructions with flash
+ * page buffer, write cycle times (RDY/BSY and polling), and sck checked
+ * against the target clock
+ *
+ * when released from reset with BOOTRST programmed, the core (cpu.h) runs
+ * the code at the start of the boot section, which is the loader stub */
+
+struct target_device_t {
+    const char *name;
+    uint8_t signature[3];
+    uint32_t flash_size;        /* bytes */
+    uint16_t flash_pagesize;    /* bytes */
+    uint16_t eeprom_size;
+    /* write cycle times in us */
+    uint16_t flash_write;
+    uint16_t eeprom_write;
+    uint16_t chip_erase;
+    uint16_t fuse_write;
+    /* factory defaults: low, high, extended fuse and lock bits */
+    uint8_t fuses[4];
+    /* smallest boot section (BOOTSZ 11) in bytes, number of the loader stub
+     * image (STUB_MCUS in the Makefile), io address of PINB */
+    uint16_t boot_min;
+    uint8_t stub_image;
+    uint8_t pinb;
+};
+
+extern const struct target_device_t target_atmega8;
+extern const struct target_device_t target_atmega328p;
+
+#define TARGET_FLASH_MAX    (32*1024UL)
+#define TARGET_EEPROM_MAX   1024
+#define TARGET_RAM_MAX      0x900
+
+struct target_stats_t {
+    uint32_t instructions;  /* complete 4 byte instructions */
+    uint32_t page_writes;
+    uint32_t eeprom_writes;
+    uint32_t busy_polls;    /* reads and RDY/BSY while busy */
+    uint32_t garbled;       /* bytes clocked faster than the target can sample */
+    uint32_t violations;    /* writes while busy and unknown instructions,
+                               resets while the stub writes, see cpu.h */
+    /* from the start of each write cycle to the first instruction after it
+     * ended, the time spent in poll loops and wait delays */
+    uint64_t wait_cycles;
+};
+
+extern struct target_stats_t target_stats;
+extern uint8_t target_flash[TARGET_FLASH_MAX];
+extern uint8_t target_eeprom[TARGET_EEPROM_MAX];
+extern uint8_t target_fuses[4];
+
+/* erased device with factory fuses, clock is the target frequency in Hz */
+void target_init(const struct target_device_t *device, uint32_t clock);
+
+/* reset line, active low */
+void target_reset(bool active);
+/* byte shifted out on MISO during the current transfer */
+uint8_t target_out(void);
+/* byte received on MOSI, half_period is the shortest sck phase in cycles of
+ * the programmer */
+void target_in(uint8_t data, uint32_t half_period);
+/* hardware spi transfer, returns the byte sent on MISO */
+uint8_t target_transfer(uint8_t data, uint32_t half_period);
+/* MISO between hardware spi transfers */
+bool target_miso(void);
+
+/* simulated tinyAVR on the updi pin: the data space is a plain memory (no
+ * nvm controller), the signature is at 0x1100 */
+#define TARGET_UPDI_SIGNATURE   0x1100
+
+extern uint8_t target_updi_memory[0x10000];
+
+void target_updi_init(const uint8_t signature[3]);
+/* line held low for longer than a frame */
+void target_updi_break(void);
+/* byte received on the line, the response (up to 256 bytes) is put into
+ * data, returns its length */
+uint16_t target_updi_rx(uint8_t byte, uint8_t *data);
+
+#endif
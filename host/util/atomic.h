@@ -0,0 +1,50 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* util/atomic.h for the host build: the block runs with the I flag in SREG
+ * cleared, SREG is restored afterwards (also for ATOMIC_FORCEON) */
+
+#ifndef __HOST_UTIL_ATOMIC_H
+#define __HOST_UTIL_ATOMIC_H
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+static inline uint8_t host_atomic_start(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    return sreg;
+}
+
+#define ATOMIC_BLOCK(type) \
+    for (uint8_t host_sreg = host_atomic_start(), host_once = 1; host_once; \
+            SREG = host_sreg, host_once = 0)
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+#endif
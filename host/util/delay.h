@@ -0,0 +1,42 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* util/delay.h for the host build: delays advance the simulated time by the
+ * cycles the loops take on the avr */
+
+#ifndef __HOST_UTIL_DELAY_H
+#define __HOST_UTIL_DELAY_H
+
+#include <stdint.h>
+
+/* 3 cycles per iteration, 0 is 256 iterations */
+void _delay_loop_1(uint8_t count);
+/* 4 cycles per iteration, 0 is 65536 iterations */
+void _delay_loop_2(uint16_t count);
+
+void _delay_us(double us);
+void _delay_ms(double ms);
+
+#endif
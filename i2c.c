@@ -0,0 +1,281 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <util/delay.h>
+#include "config.h"
+#include "spi.h"
+#include "i2c.h"
+
+#ifdef ENABLE_I2C
+
+#define I2C_DEVICE  0xa0
+#define I2C_READ    0x01
+
+#define SDA     SPI_MOSI
+#define SCL     SPI_SCK
+
+static struct {
+    enum {
+        STREAM_NONE = 0,
+        STREAM_READ,
+        STREAM_WRITE,
+    } stream;
+    uint16_t next;          /* next address of the current transfer */
+    uint16_t pagesize;
+    uint8_t address_bytes;
+    bool failed;            /* a missing ack since the last i2c_ok() */
+} i2c;
+
+/* lines are driven low by setting them to output (PORT is 0), and released
+ * to the pullups by setting them to input */
+static void i2c_line(uint8_t pin, bool high)
+{
+    if (high)
+        SPI_DDR &= ~_BV(pin);
+    else
+        SPI_DDR |= _BV(pin);
+
+    _delay_loop_2(I2C_DELAY);
+}
+
+static void i2c_start(void)
+{
+    i2c_line(SDA, true);
+    i2c_line(SCL, true);
+    i2c_line(SDA, false);
+    i2c_line(SCL, false);
+}
+
+static void i2c_stop(void)
+{
+    i2c_line(SDA, false);
+    i2c_line(SCL, true);
+    i2c_line(SDA, true);
+}
+
+static uint8_t i2c_bit(uint8_t bit)
+{
+    i2c_line(SDA, bit);
+    i2c_line(SCL, true);
+
+    /* clock stretching */
+    for (uint8_t i = 255; i && !(SPI_PIN & _BV(SCL)); i--);
+    bit = (SPI_PIN & _BV(SDA)) ? 1 : 0;
+
+    i2c_line(SCL, false);
+
+    return bit;
+}
+
+/* returns true if the byte has been acknowledged */
+static bool i2c_send(uint8_t data)
+{
+    for (uint8_t i = 0; i < 8; i++) {
+        i2c_bit(data & _BV(7));
+        data <<= 1;
+    }
+
+    return i2c_bit(1) == 0;
+}
+
+/* the acknowledge is sent by the next i2c_recv() or i2c_finish() */
+static uint8_t i2c_recv(void)
+{
+    uint8_t data = 0;
+
+    for (uint8_t i = 0; i < 8; i++)
+        data = (data << 1) | i2c_bit(1);
+
+    return data;
+}
+
+static uint8_t i2c_device(uint16_t address)
+{
+    /* 24C04-24C16 select 256 byte blocks in the device address */
+    if (i2c.address_bytes == 1)
+        return I2C_DEVICE | ((HI8(address) << 1) & 0x0e);
+    return I2C_DEVICE;
+}
+
+/* select the device and send the address, returns false and releases the
+ * bus if there is no ack */
+static bool i2c_address(uint16_t address)
+{
+    i2c_start();
+    bool ack = i2c_send(i2c_device(address));
+
+    if (ack && i2c.address_bytes > 1)
+        ack = i2c_send(HI8(address));
+    if (ack)
+        ack = i2c_send(LO8(address));
+
+    if (!ack) {
+        i2c_stop();
+        i2c.failed = true;
+    }
+
+    return ack;
+}
+
+/* the device does not acknowledge its address until the write cycle is done */
+static void i2c_poll(uint16_t address)
+{
+    for (uint8_t i = 0; i < I2C_POLL_TRIES; i++) {
+        i2c_start();
+        if (i2c_send(i2c_device(address))) {
+            i2c_stop();
+            return;
+        }
+    }
+
+    i2c_stop();
+    i2c.failed = true;
+}
+
+bool i2c_init(uint16_t pagesize, uint8_t address_bytes)
+{
+    /* the page is found by masking the address */
+    if (pagesize == 0 || pagesize > 256 || (pagesize & (pagesize - 1)))
+        return false;
+    if (address_bytes != 1 && address_bytes != 2)
+        return false;
+
+    i2c.pagesize = pagesize;
+    i2c.address_bytes = address_bytes;
+
+    return true;
+}
+
+bool i2c_ok(void)
+{
+    bool ok = !i2c.failed;
+    i2c.failed = false;
+
+    return ok;
+}
+
+static bool i2c_attach(uint8_t freq)
+{
+    (void)freq;
+
+    /* release both lines, PORT stays 0 */
+    SPI_PORT &= ~(_BV(SDA) | _BV(SCL));
+    i2c_line(SCL, true);
+    i2c_line(SDA, true);
+
+    /* forget a transfer started before */
+    i2c.stream = STREAM_NONE;
+    i2c.failed = false;
+
+    i2c_start();
+    bool ack = i2c_send(I2C_DEVICE);
+    i2c_stop();
+
+    return ack;
+}
+
+static void i2c_finish(void)
+{
+    if (i2c.stream == STREAM_READ) {
+        /* nack the last byte */
+        i2c_bit(1);
+        i2c_stop();
+    } else if (i2c.stream == STREAM_WRITE) {
+        i2c_stop();
+        i2c_poll(i2c.next - 1);
+    }
+
+    i2c.stream = STREAM_NONE;
+}
+
+/* i2c eeproms can be accessed as flash or eeprom */
+static uint8_t i2c_read(uint16_t address, bool eeprom)
+{
+    (void)eeprom;
+
+    if (i2c.stream == STREAM_READ && address == i2c.next) {
+        /* ack the previous byte */
+        i2c_bit(0);
+    } else {
+        i2c_finish();
+
+        /* set the address with a write, then read sequentially */
+        if (i2c.failed || !i2c_address(address))
+            return 0xff;
+
+        i2c_start();
+        if (!i2c_send(i2c_device(address) | I2C_READ)) {
+            i2c_stop();
+            i2c.failed = true;
+            return 0xff;
+        }
+        i2c.stream = STREAM_READ;
+    }
+
+    i2c.next = address + 1;
+    return i2c_recv();
+}
+
+static void i2c_write(uint16_t address, uint8_t data, uint8_t memory)
+{
+    (void)memory;
+
+    if (i2c.stream != STREAM_WRITE || address != i2c.next
+            || (address & (i2c.pagesize-1)) == 0) {
+        i2c_finish();
+
+        if (i2c.failed || !i2c_address(address))
+            return;
+        i2c.stream = STREAM_WRITE;
+    }
+
+    if (!i2c_send(data))
+        i2c.failed = true;
+    i2c.next = address + 1;
+
+    /* the page is written after the stop condition */
+    if ((i2c.next & (i2c.pagesize-1)) == 0)
+        i2c_finish();
+}
+
+/* the page is written after the last byte or the stop condition */
+static void i2c_write_page(uint16_t address)
+{
+    (void)address;
+    i2c_finish();
+}
+
+const struct isp_family_t i2c_family = {
+    .attach = i2c_attach,
+    .read = i2c_read,
+    .write = i2c_write,
+    .write_page = i2c_write_page,
+    .finish = i2c_finish,
+};
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __I2C_H
+#define __I2C_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "spi.h"
+
+/* 24Cxx i2c eeproms on the isp header: SDA on MOSI, SCL on SCK, both open
+ * drain (pullups required), bit-banged at ~100kHz
+ *
+ * consecutive addresses are read sequentially and written into the same
+ * page, completion of a page write is detected by ack polling */
+
+/* pagesize of the device (a power of two up to 256, 1 for byte writes),
+ * address_bytes is 1 (24C01-24C16, higher address bits are sent in the
+ * device address) or 2 (24C32 and larger), returns false if one is invalid */
+bool i2c_init(uint16_t pagesize, uint8_t address_bytes);
+
+/* returns false if an ack was missing since the last call: the device did
+ * not answer its address or a byte, or a write cycle did not end within
+ * I2C_POLL_TRIES */
+bool i2c_ok(void);
+
+/* selected by isp_set_family(ISP_FAMILY_I2C) */
+extern const struct isp_family_t i2c_family;
+
+#endif
@@ -28,13 +28,17 @@
 #include <avr/pgmspace.h>
 #include <avr/boot.h>
 #include <avr/eeprom.h>
-#include <util/delay.h>
 #include <string.h>
 
 #include "config.h"
+#include "platform.h"
 #include "timer.h"
 #include "usb.h"
 #include "debug.h"
+#include "standalone.h"
+#include "patch.h"
+#include "profile.h"
+#include "telemetry.h"
 
 int main(void)
 {
@@ -46,11 +50,16 @@ int main(void)
     LED1_OFF();
     LED2_OFF();
 
-    /* disconnect for ~500ms, so that the host re-enumerates this device */
-    usb_disable();
-    for (uint8_t i = 0; i < 38; i++)
-        _delay_loop_2(0); /* 0 means 0x10000, 38*1/f*0x10000 =~ 498ms */
-    usb_enable();
+    /* read and clear the reset cause */
+    uint8_t reset = MCUSR;
+    MCUSR = 0;
+
+    /* after a power-on reset the host has never seen this device, otherwise
+     * make the host re-enumerate it */
+    if (reset & _BV(PORF))
+        usb_enable();
+    else
+        usb_reconnect();
 
     /* initialize usb pins */
     usb_init();
@@ -61,15 +70,47 @@ int main(void)
     /* init timer */
     timer_init();
 
+#ifdef ENABLE_PROFILE
+    profile_init();
+#endif
+
+#ifdef ENABLE_PATCH
+    patch_init();
+#endif
+
+#ifdef ENABLE_TELEMETRY
+    telemetry_init();
+#endif
+
+#ifdef ENABLE_STANDALONE
+    standalone_init();
+#endif
+
     timer_t blink_timer;
-    timer_set(&blink_timer, 50);
+    timer_set(&blink_timer, 500);
     while(1) {
         usb_poll();
 
+#ifdef ENABLE_TELEMETRY_LIFETIME
+        telemetry_poll();
+#endif
+
+#ifdef ENABLE_STANDALONE
+        standalone_poll();
+#endif
+
+#ifdef ENABLE_PATCH
+        patch_poll();
+#endif
+
         /* do some led blinking, so that it is visible that the programmer is running */
         if (timer_expired(&blink_timer)) {
+#ifdef ENABLE_STANDALONE
+            /* unless the leds show the result of a standalone run */
+            if (standalone_result() == STANDALONE_NONE)
+#endif
             LED2_TOGGLE();
-            timer_set(&blink_timer, 50);
+            timer_set(&blink_timer, 500);
         }
     }
 }
@@ -0,0 +1,66 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "config.h"
+#include "memory.h"
+
+#ifdef ENABLE_MEMORY_STATS
+
+/* defined by the linker script */
+extern uint8_t __data_start;
+extern uint8_t __heap_start;
+
+/* NEVER CALL DIRECTLY, WILL BE CALLED BY STARTUP CODE! */
+void __init_memory (void) __attribute__ ((naked))
+    __attribute__ ((section (".init5")));
+
+/* NEVER CALL DIRECTLY, WILL BE CALLED BY STARTUP CODE!
+ *
+ * runs after .data and .bss have been initialized (and after the random
+ * seed has been taken from the old ram contents in .init3) */
+void __init_memory (void)
+{
+    uint8_t *ptr = &__heap_start;
+
+    while (ptr < (uint8_t *)SP)
+        *(ptr++) = MEMORY_PAINT;
+}
+
+void memory_read(struct memory_t *m)
+{
+    uint8_t *ptr = &__heap_start;
+
+    while (ptr <= (uint8_t *)RAMEND && *ptr == MEMORY_PAINT)
+        ptr++;
+
+    m->stack = (uint8_t *)RAMEND - ptr + 1;
+    m->unused = ptr - &__heap_start;
+    m->free = (uint8_t *)SP - &__heap_start;
+    m->data = &__heap_start - &__data_start;
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __MEMORY_H
+#define __MEMORY_H
+
+#include <stdint.h>
+
+/* sram use: the free ram between the static data and the stack is painted
+ * with MEMORY_PAINT by the startup code, the deepest stack use is found by
+ * looking for the first byte which has been overwritten (the firmware does
+ * not use malloc(), so there is no heap)
+ *
+ * a stack byte which happens to be MEMORY_PAINT is taken for unused, so
+ * the high-water mark can be a few bytes too low */
+#define MEMORY_PAINT    0xc5
+
+/* returned by FUNC_MEMORY, little endian */
+struct memory_t {
+    uint16_t stack;     /* deepest stack use since reset */
+    uint16_t unused;    /* bytes below the stack which have never been used */
+    uint16_t free;      /* bytes between the static data and the stack pointer */
+    uint16_t data;      /* static data: .data, .bss and .noinit */
+};
+
+#ifdef ENABLE_MEMORY_STATS
+void memory_read(struct memory_t *m);
+#endif
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "config.h"
+#include "patch.h"
+#include "spi.h"
+#include "usb.h"
+
+#ifdef ENABLE_PATCH
+
+static struct {
+    struct patch_t table[PATCH_ENTRIES];
+    uint32_t counter;
+    bool enabled;
+    uint8_t applied;        /* entries, one bit each */
+} patch;
+
+#define PATCH_SAVE_BYTES    (sizeof(patch.table) + sizeof(patch.counter))
+
+/* next byte to be compared with the eeprom, PATCH_SAVE_BYTES when idle */
+static uint8_t save_offset = PATCH_SAVE_BYTES;
+
+static uint8_t format(uint8_t flags, uint8_t pos)
+{
+    uint32_t value = patch.counter;
+
+    switch (flags & PATCH_FORMAT_MASK) {
+        case PATCH_LE:
+        case PATCH_BE:
+            return pos < 4 ? value >> (8*pos) : 0;
+        case PATCH_HEX:
+            value = pos < 8 ? (value >> (4*pos)) & 0x0f : 0;
+            return value < 10 ? '0' + value : 'A' - 10 + value;
+        default:
+            while (pos--)
+                value /= 10;
+            return '0' + value % 10;
+    }
+}
+
+void patch_enable(bool enable)
+{
+    patch.enabled = enable;
+    patch.applied = 0;
+}
+
+/* byte at offset of an entry */
+static uint8_t patched(struct patch_t *p, uint8_t offset)
+{
+    /* pos counts from the least significant byte or digit */
+    if ((p->flags & PATCH_FORMAT_MASK) != PATCH_LE)
+        offset = p->length - 1 - offset;
+    return format(p->flags, offset);
+}
+
+uint8_t patch_apply(uint8_t memory, uint16_t address, uint8_t data)
+{
+    if (!patch.enabled)
+        return data;
+
+    for (uint8_t i = 0; i < PATCH_ENTRIES; i++) {
+        struct patch_t *p = &patch.table[i];
+
+        if ((p->flags & PATCH_EEPROM) != memory)
+            continue;
+
+        uint16_t offset = address - p->address;
+        if (offset >= p->length)
+            continue;
+
+        patch.applied |= _BV(i);
+        return patched(p, offset);
+    }
+
+    return data;
+}
+
+bool patch_verify(void)
+{
+    for (uint8_t i = 0; i < PATCH_ENTRIES; i++) {
+        struct patch_t *p = &patch.table[i];
+
+        if (!(patch.applied & _BV(i)))
+            continue;
+
+        for (uint8_t offset = 0; offset < p->length; offset++) {
+            uint16_t address = p->address + offset;
+            uint8_t data = p->flags & PATCH_EEPROM ? isp_read_eeprom(address)
+                : isp_read_flash(address);
+
+            if (data != patched(p, offset))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void patch_next(void)
+{
+    if (!patch.applied)
+        return;
+
+    patch.applied = 0;
+    patch_set_counter(patch.counter + 1);
+}
+
+uint32_t patch_counter(void)
+{
+    return patch.counter;
+}
+
+void patch_set_counter(uint32_t counter)
+{
+    patch.counter = counter;
+    save_offset = 0;
+}
+
+void patch_set(uint8_t entry, uint16_t address, uint8_t length, uint8_t flags)
+{
+    if (entry >= PATCH_ENTRIES)
+        return;
+
+    struct patch_t *p = &patch.table[entry];
+    p->address = address;
+    p->length = length;
+    p->flags = flags;
+    save_offset = 0;
+}
+
+void patch_poll(void)
+{
+    /* one byte per call, so that usb_poll() is not blocked by the 8.5ms
+     * eeprom write cycles, unchanged bytes are not written at all */
+    while (save_offset < PATCH_SAVE_BYTES && eeprom_is_ready()) {
+        uint8_t *p, data;
+
+        /* there may be padding in front of the counter, the host build has
+         * some in eeprom_storage */
+        if (save_offset < sizeof(patch.table)) {
+            p = (uint8_t *)eeprom_storage.patches + save_offset;
+            data = ((uint8_t *)patch.table)[save_offset];
+        } else {
+            p = (uint8_t *)&eeprom_storage.patch_counter + save_offset - sizeof(patch.table);
+            data = ((uint8_t *)&patch.counter)[save_offset - sizeof(patch.table)];
+        }
+        save_offset++;
+
+        if (eeprom_read_byte(p) != data) {
+            eeprom_write_byte(p, data);
+            break;
+        }
+    }
+}
+
+void patch_init(void)
+{
+    eeprom_read_block(patch.table, eeprom_storage.patches, sizeof(patch.table));
+    patch.counter = eeprom_read_dword(&eeprom_storage.patch_counter);
+
+    /* erased eeprom */
+    for (uint8_t i = 0; i < PATCH_ENTRIES; i++) {
+        if (patch.table[i].length == 0xff)
+            patch.table[i].length = 0;
+    }
+}
+
+#endif
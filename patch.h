@@ -0,0 +1,77 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __PATCH_H
+#define __PATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* per-unit data (serial numbers, mac addresses) injected into the flash or
+ * eeprom data while it is written, generated from a counter which is
+ * incremented for each programmed and verified unit
+ *
+ * patching is off until enabled for a usb session (FUNC_PATCH_ENABLE, up to
+ * the next disconnect) or a standalone run.  the host's verify sees the
+ * patched bytes, so run avrdude with -V, the patched bytes are verified on
+ * disconnect instead */
+struct patch_t {
+    uint16_t address;
+    uint8_t length;         /* 0 disables the entry */
+    uint8_t flags;
+};
+
+/* flags: memory and format of the counter */
+#define PATCH_EEPROM        _BV(2)
+#define PATCH_FORMAT_MASK   0x03
+#define PATCH_LE            0       /* binary, little endian */
+#define PATCH_BE            1       /* binary, big endian */
+#define PATCH_HEX           2       /* ascii hex digits */
+#define PATCH_DEC           3       /* ascii decimal digits */
+
+/* load patch table and counter from eeprom */
+void patch_init(void);
+/* configure an entry, stored in eeprom by patch_poll() */
+void patch_set(uint8_t entry, uint16_t address, uint8_t length, uint8_t flags);
+uint32_t patch_counter(void);
+void patch_set_counter(uint32_t counter);
+/* called from the main loop, writes changed table and counter bytes to the
+ * eeprom one at a time */
+void patch_poll(void);
+
+/* patch the data of the following writes, disabling discards the patched
+ * state without incrementing the counter */
+void patch_enable(bool enable);
+
+/* return data for address in flash (memory 0) or eeprom (PATCH_EEPROM),
+ * patched if enabled and an entry covers it */
+uint8_t patch_apply(uint8_t memory, uint16_t address, uint8_t data);
+/* read back the patched bytes from the target in programming mode */
+bool patch_verify(void);
+/* a unit has been programmed and verified, increment the counter if data
+ * was patched */
+void patch_next(void);
+
+#endif
@@ -73,6 +73,105 @@
 #define U2X0 U2X
 #endif
 
+#if !defined(RXEN0) && defined(RXEN)
+#define RXEN0 RXEN
+#endif
+
+#if !defined(RXCIE0) && defined(RXCIE)
+#define RXCIE0 RXCIE
+#endif
+
+#if !defined(UDRIE0) && defined(UDRIE)
+#define UDRIE0 UDRIE
+#endif
+
+#if !defined(RXC0) && defined(RXC)
+#define RXC0 RXC
+#endif
+
+#if !defined(UPM01) && defined(UPM1)
+#define UPM01 UPM1
+#endif
+
+#if !defined(USBS0) && defined(USBS)
+#define USBS0 USBS
+#endif
+
+#if !defined(FE0) && defined(FE)
+#define FE0 FE
+#endif
+
+#if !defined(DOR0) && defined(DOR)
+#define DOR0 DOR
+#endif
+
+#if !defined(UPE0) && defined(PE)
+#define UPE0 PE
+#endif
+
+/* UCSRC shares its address with UBRRH on some devices */
+#ifdef URSEL
+#define UCSR0C_SELECT _BV(URSEL)
+#else
+#define UCSR0C_SELECT 0
+#endif
+
+#if defined(__AVR_ATmega8__)
+    #define UART_RX_VECT USART_RXC_vect
+#elif defined(__AVR_ATmega48__) || defined(__AVR_ATmega88__) || defined(__AVR_ATmega168__)
+    #define UART_RX_VECT USART_RX_vect
+#else
+    #error "unsupported platform!"
+#endif
+#define UART_UDRE_VECT USART_UDRE_vect
+
+/* handlers jumped to by naked interrupt stubs are named like vectors, so that
+ * gcc accepts the signal attribute, which only exists for the avr */
+#ifdef __AVR__
+#define ISR_HANDLER __attribute__((signal, used))
+#else
+#define ISR_HANDLER __attribute__((used))
+#endif
+
+#ifdef __AVR__
+/* usb interrupts must not be delayed by more than a few cycles (see usbdrv.h),
+ * the uart interrupts cannot enable interrupts right away (their flags are
+ * still set), so mask the source, enable interrupts and jump to the handler,
+ * which unmasks it again */
+#define UART_ISR(vect, handler, bit) \
+ISR(vect, ISR_NAKED) \
+{ \
+    asm volatile( \
+        "push r24"              "\n\t" \
+        "in r24, __SREG__"      "\n\t" \
+        "push r24"              "\n\t" \
+        "lds r24, %[ucsrb]"     "\n\t" \
+        "andi r24, %[mask]"     "\n\t" \
+        "sts %[ucsrb], r24"     "\n\t" \
+        "pop r24"               "\n\t" \
+        "out __SREG__, r24"     "\n\t" \
+        "pop r24"               "\n\t" \
+        "sei"                   "\n\t" \
+        "%~jmp " #handler       "\n\t" \
+        :: [ucsrb] "i" (_SFR_MEM_ADDR(UCSR0B)), \
+           [mask] "M" ((uint8_t)~_BV(bit))); \
+}
+#else
+/* the host build calls the vectors with interrupts disabled, like the avr */
+#define UART_ISR(vect, handler, bit) \
+ISR(vect) \
+{ \
+    UCSR0B &= ~_BV(bit); \
+    sei(); \
+    handler(); \
+}
+#endif
+
+/* reset cause */
+#if !defined(MCUSR) && defined(MCUCSR)
+#define MCUSR MCUCSR
+#endif
+
 /* timer */
 #if !defined(OCR2A) && defined(OCR2)
 #define OCR2A OCR2
@@ -94,4 +193,28 @@
 #define OCIE2A OCIE2
 #endif
 
+#if !defined(TIFR2) && defined(TIFR)
+#define TIFR2 TIFR
+#endif
+
+#if !defined(TIMSK1) && defined(TIMSK)
+#define TIMSK1 TIMSK
+#endif
+
+#if !defined(TIFR1) && defined(TIFR)
+#define TIFR1 TIFR
+#endif
+
+#if !defined(TCCR0B) && defined(TCCR0)
+#define TCCR0B TCCR0
+#endif
+
+#if !defined(TIMSK0) && defined(TIMSK)
+#define TIMSK0 TIMSK
+#endif
+
+#if !defined(TIFR0) && defined(TIFR)
+#define TIFR0 TIFR
+#endif
+
 #endif
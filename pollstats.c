@@ -0,0 +1,110 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "config.h"
+#include "timer.h"
+#include "pollstats.h"
+
+#ifdef ENABLE_POLL_STATS
+
+/* worst case time of a single usb callback in cycles: a packet of 8 eeprom
+ * bytes or flash bytes without page buffer (each waits for the write cycle of
+ * the previous one), the write cycle of a page started by the previous packet,
+ * and entering programming mode in auto mode with hardware spi at F_CPU/128
+ * and the default software delay, the spi transfers while polling and usb
+ * interrupts are not included */
+#define POLL_LIMIT          (F_CPU/1000*50)
+#define POLL_WORST_EEPROM   (8*EEPROM_WRITE_TIMEOUT_MS*(F_CPU/1000))
+#define POLL_WORST_FLASH    (8*FLASH_WRITE_TIMEOUT_MS*(F_CPU/1000))
+#define POLL_WORST_PAGE     (FLASH_PAGE_TIMEOUT_MS*(F_CPU/1000))
+#define POLL_WORST_ATTACH   (SPI_MAX_TRIES_HW*4*8*128UL + SPI_MAX_TRIES_SW*(4*8+1)*2*4UL*DEFAULT_SPI_SW_DELAY)
+
+/* a packet of eeprom bytes always exceeds the limit (usbasp protocol), this
+ * is only reported in poll_stats.over, the others depend on config.h */
+#define POLL_OVER   ((POLL_WORST_EEPROM > POLL_LIMIT ? POLL_OVER_EEPROM : 0) \
+        | (POLL_WORST_FLASH > POLL_LIMIT ? POLL_OVER_FLASH : 0) \
+        | (POLL_WORST_PAGE > POLL_LIMIT ? POLL_OVER_PAGE : 0) \
+        | (POLL_WORST_ATTACH > POLL_LIMIT ? POLL_OVER_ATTACH : 0))
+
+#if POLL_WORST_FLASH > POLL_LIMIT
+#warning "flash writes without page buffer may delay usb_poll() by more than 50ms"
+#endif
+#if POLL_WORST_PAGE > POLL_LIMIT
+#warning "flash page writes may delay usb_poll() by more than 50ms"
+#endif
+#if POLL_WORST_ATTACH > POLL_LIMIT
+#warning "entering programming mode may delay usb_poll() by more than 50ms"
+#endif
+
+#define POLL_STEPS(ms)  ((ms) * (F_CPU/TIMER_STEP_CYCLES) / 1000)
+
+/* upper limits of the histogram buckets */
+static const uint16_t poll_limits[POLL_BUCKETS-1] PROGMEM = {
+    POLL_STEPS(1), POLL_STEPS(2), POLL_STEPS(5), POLL_STEPS(10),
+    POLL_STEPS(20), POLL_STEPS(50), POLL_STEPS(100),
+};
+
+struct poll_stats_t poll_stats = { .over = POLL_OVER };
+uint8_t poll_stats_request;
+
+static uint16_t last;
+static bool started;
+
+void poll_stats_update(void)
+{
+    uint16_t gap = timer_since(last);
+    last = timer_timestamp();
+
+    /* the first call has nothing to compare with */
+    if (!started) {
+        started = true;
+        return;
+    }
+
+    if (gap > poll_stats.max) {
+        poll_stats.max = gap;
+        poll_stats.max_request = poll_stats_request;
+    }
+
+    uint8_t i = 0;
+    while (i < POLL_BUCKETS-1 && gap > pgm_read_word(&poll_limits[i]))
+        i++;
+
+    if (poll_stats.histogram[i] < UINT16_MAX)
+        poll_stats.histogram[i]++;
+}
+
+void poll_stats_reset(void)
+{
+    memset(&poll_stats, 0, sizeof(poll_stats));
+    poll_stats.over = POLL_OVER;
+}
+
+#endif
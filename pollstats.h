@@ -0,0 +1,61 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __POLLSTATS_H
+#define __POLLSTATS_H
+
+#include <stdint.h>
+
+/* statistics of the gaps between usb_poll() calls, which must not exceed
+ * 50ms, in timer steps (see timer.h) */
+
+#define POLL_BUCKETS    8
+
+/* callbacks whose worst case exceeds 50ms in this build */
+#define POLL_OVER_EEPROM    _BV(0)  /* always, 8 bytes per usbasp packet */
+#define POLL_OVER_FLASH     _BV(1)  /* flash without page buffer */
+#define POLL_OVER_PAGE      _BV(2)
+#define POLL_OVER_ATTACH    _BV(3)
+
+/* returned by FUNC_POLL_STATS, little endian */
+struct poll_stats_t {
+    uint16_t max;
+    uint8_t max_request;    /* last request received before the longest gap */
+    /* gaps up to 1, 2, 5, 10, 20, 50, 100ms and longer */
+    uint16_t histogram[POLL_BUCKETS];
+    uint8_t over;           /* POLL_OVER_*, not cleared by a reset */
+};
+
+#ifdef ENABLE_POLL_STATS
+extern struct poll_stats_t poll_stats;
+/* bRequest of the last setup packet */
+extern uint8_t poll_stats_request;
+
+/* called by usb_poll() */
+void poll_stats_update(void);
+void poll_stats_reset(void);
+#endif
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "config.h"
+#include "platform.h"
+#include "profile.h"
+
+#ifdef ENABLE_PROFILE
+
+struct profile_t profile[PROFILE_SECTIONS];
+
+static const uint8_t requests[] PROGMEM = PROFILE_REQUEST_LIST;
+
+/* upper 16 bit of the cycle counter */
+static volatile uint16_t overflows;
+
+void profile_init(void)
+{
+    /* timer1 in normal mode without prescaler, TIMSK is shared with timer2
+     * on the atmega8 */
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+    TIMSK1 |= _BV(TOIE1);
+}
+
+void profile_reset(void)
+{
+    memset(profile, 0, sizeof(profile));
+}
+
+uint32_t profile_now(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    uint16_t low = TCNT1;
+    uint16_t high = overflows;
+
+    /* overflow which has not been handled yet */
+    if ((TIFR1 & _BV(TOV1)) && low < 0x8000)
+        high++;
+
+    SREG = sreg;
+
+    return (uint32_t)high << 16 | low;
+}
+
+static void update(uint8_t section, uint32_t cycles)
+{
+    struct profile_t *p = &profile[section];
+
+    /* the counters stop instead of wrapping */
+    if (p->count == UINT16_MAX || p->total + cycles < p->total)
+        return;
+
+    p->count++;
+    p->total += cycles;
+    if (cycles > p->max)
+        p->max = cycles;
+}
+
+void profile_add(uint8_t section, uint32_t start)
+{
+    update(section, profile_now() - start);
+}
+
+void profile_add_request(uint8_t request, uint32_t start)
+{
+    uint32_t cycles = profile_now() - start;
+    uint8_t section = 0;
+
+    while (section < sizeof(requests) && pgm_read_byte(&requests[section]) != request)
+        section++;
+
+    update(section, cycles);
+}
+
+#if __AVR_LIBC_VERSION__ < 10600UL
+ISR(TIMER1_OVF_vect)
+#else
+ISR(TIMER1_OVF_vect, ISR_NOBLOCK)
+#endif
+{
+    overflows++;
+}
+
+#endif
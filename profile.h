@@ -0,0 +1,72 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <stdint.h>
+
+/* cycle profiler: timer1 runs as a free running counter (extended to 32 bit
+ * by the overflow interrupt), the sections below record their count, total
+ * and maximum number of cycles, including the time spent in interrupts */
+
+/* usbFunctionSetup() for each request of PROFILE_REQUEST_LIST (config.h) in
+ * that order, the other requests share the entry after them */
+#define PROFILE_REQUESTS        (sizeof((uint8_t[])PROFILE_REQUEST_LIST) + 1)
+#define PROFILE_USB_READ        (PROFILE_REQUESTS+0)    /* usbFunctionRead() */
+#define PROFILE_USB_WRITE       (PROFILE_REQUESTS+1)    /* usbFunctionWrite() */
+#define PROFILE_ISP_ATTACH      (PROFILE_REQUESTS+2)
+#define PROFILE_FLASH_WAIT      (PROFILE_REQUESTS+3)    /* flash poll loops */
+#define PROFILE_EEPROM_WAIT     (PROFILE_REQUESTS+4)    /* eeprom poll loops */
+#define PROFILE_SECTIONS        (PROFILE_REQUESTS+5)
+
+/* returned by FUNC_PROFILE_READ from a byte offset on, 10 bytes per
+ * section, little endian */
+struct profile_t {
+    uint16_t count;
+    uint32_t total;
+    uint32_t max;
+};
+
+#ifdef ENABLE_PROFILE
+extern struct profile_t profile[PROFILE_SECTIONS];
+
+void profile_init(void);
+void profile_reset(void);
+uint32_t profile_now(void);
+void profile_add(uint8_t section, uint32_t start);
+/* the section of a request is looked up after the measurement */
+void profile_add_request(uint8_t request, uint32_t start);
+
+#define PROFILE_START(start)            uint32_t start = profile_now()
+#define PROFILE_STOP(section, start)    profile_add(section, start)
+#define PROFILE_STOP_REQUEST(request, start)    profile_add_request(request, start)
+#else
+#define PROFILE_START(start)
+#define PROFILE_STOP(section, start)
+#define PROFILE_STOP_REQUEST(request, start)
+#endif
+
+#endif
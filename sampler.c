@@ -0,0 +1,125 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "config.h"
+#include "platform.h"
+#include "sampler.h"
+
+#ifdef ENABLE_SAMPLER
+
+struct sampler_t sampler;
+
+/* word address of the last sample, set by the stub below */
+static volatile uint16_t sample;
+
+void sampler_start(uint8_t rate, uint8_t shift, uint16_t base)
+{
+    TCCR0B = 0;
+    TIMSK0 &= ~_BV(TOIE0);
+    sampler.rate = 0;
+
+    /* stopped, the histogram can still be read (clock selects above 5 are
+     * external clocks) */
+    if (rate == 0 || rate > 5)
+        return;
+
+    memset(&sampler, 0, sizeof(sampler));
+    sampler.base = base;
+    sampler.shift = shift;
+    sampler.rate = rate;
+    TCNT0 = 0;
+    TIFR0 = _BV(TOV0);
+    TIMSK0 |= _BV(TOIE0);
+    TCCR0B = rate;
+}
+
+/* called by the stub below with the timer0 overflow interrupt masked, so that
+ * it does not interrupt itself at high rates, and interrupts enabled */
+void __vector_sampler(void) ISR_HANDLER;
+void __vector_sampler(void)
+{
+    uint16_t offset = sample - sampler.base;
+    uint16_t *p = &sampler.outside;
+
+    if (sample >= sampler.base && (offset >> sampler.shift) < SAMPLER_BINS)
+        p = &sampler.bins[offset >> sampler.shift];
+
+    /* the counters stop instead of wrapping */
+    if (*p != UINT16_MAX)
+        (*p)++;
+
+    cli();
+    TIMSK0 |= _BV(TOIE0);
+}
+
+#ifdef __AVR__
+/* the return address is on top of the stack on entry (high byte first), fetch
+ * it, mask the interrupt and enable interrupts as soon as possible, so that
+ * the usb interrupt is not delayed (see UART_ISR() in platform.h) */
+ISR(TIMER0_OVF_vect, ISR_NAKED)
+{
+    asm volatile(
+        "push r24"              "\n\t"
+        "in r24, __SREG__"      "\n\t"
+        "push r24"              "\n\t"
+        "push r25"              "\n\t"
+        "push r30"              "\n\t"
+        "push r31"              "\n\t"
+        "in r30, __SP_L__"      "\n\t"
+        "in r31, __SP_H__"      "\n\t"
+        "ldd r25, Z+6"          "\n\t"
+        "ldd r24, Z+7"          "\n\t"
+        "sts %[sample]+1, r25"  "\n\t"
+        "sts %[sample], r24"    "\n\t"
+        "lds r24, %[timsk]"     "\n\t"
+        "andi r24, %[mask]"     "\n\t"
+        "sts %[timsk], r24"     "\n\t"
+        "pop r31"               "\n\t"
+        "pop r30"               "\n\t"
+        "pop r25"               "\n\t"
+        "pop r24"               "\n\t"
+        "out __SREG__, r24"     "\n\t"
+        "pop r24"               "\n\t"
+        "sei"                   "\n\t"
+        "%~jmp __vector_sampler" "\n\t"
+        :: [sample] "i" (&sample),
+           [timsk] "i" (_SFR_MEM_ADDR(TIMSK0)),
+           [mask] "i" ((uint8_t)~_BV(TOIE0)));
+}
+#else
+/* the host has no return address to sample */
+ISR(TIMER0_OVF_vect)
+{
+    TIMSK0 &= ~_BV(TOIE0);
+    sei();
+    __vector_sampler();
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __SAMPLER_H
+#define __SAMPLER_H
+
+#include <stdint.h>
+
+/* sampling profiler: the timer0 overflow interrupt records the address it
+ * interrupted in a histogram of address ranges, tools/sampler.py maps the
+ * bins to the symbols of kahuna.elf
+ *
+ * interrupts are not interrupted by the sampler, a sample taken while
+ * another interrupt (e.g. the usb receiver) runs is recorded at the address
+ * to which that interrupt returns.  the sampler does not interrupt itself
+ * either, at rate 1 (every 256 cycles) samples are lost while one is
+ * recorded */
+
+#define SAMPLER_BINS    64
+
+/* returned by FUNC_SAMPLER_READ, little endian */
+struct sampler_t {
+    uint16_t base;      /* word address of the first bin */
+    uint8_t shift;      /* each bin covers 1 << shift words */
+    uint8_t rate;       /* timer0 clock select (1-5), 0 if stopped */
+    uint16_t outside;   /* samples outside of the bins */
+    uint16_t bins[SAMPLER_BINS];
+};
+
+#ifdef ENABLE_SAMPLER
+extern struct sampler_t sampler;
+
+/* clear the histogram and take a sample every 256 timer0 clocks, e.g. every
+ * 128us with rate 2 (F_CPU/8) at 16MHz, rate 0 stops the sampler and keeps
+ * the histogram */
+void sampler_start(uint8_t rate, uint8_t shift, uint16_t base);
+#endif
+
+#endif
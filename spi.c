@@ -24,11 +24,17 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <avr/io.h>
 #include <util/delay.h>
-#include "spi.h"
 #include "config.h"
+#include "spi.h"
+#include "at89.h"
+#include "i2c.h"
 #include "debug.h"
+#include "timer.h"
+#include "profile.h"
+#include "telemetry.h"
 
 #define ISP_READY       0xF0
 #define ISP_READ_FLASH  0x20
@@ -41,38 +47,196 @@ struct spi_state_t {
     enum {
         HARDWARE = 0,
         SOFTWARE,
+        GANG,
     } mode;
     uint16_t delay;
 };
 
 struct spi_state_t spi;
 
+static bool avr_attach(uint8_t freq);
+static uint8_t avr_read(uint16_t address, bool eeprom);
+static void avr_write(uint16_t address, uint8_t data, uint8_t memory);
+static void avr_write_page(uint16_t address);
+static void avr_finish(void);
+
+/* the avr instruction set is the default */
+static const struct isp_family_t avr_family = {
+    .reset_high = false,
+    .echo_index = 2,
+    .echo = 0x53,
+    .attach = avr_attach,
+    .read = avr_read,
+    .write = avr_write,
+    .write_page = avr_write_page,
+    .finish = avr_finish,
+};
+
+static const struct isp_family_t *family = &avr_family;
+
+#ifdef ENABLE_MULTI_TARGET
+/* reset line of each target slot, settings found by isp_attach() are
+ * remembered per slot */
+static const uint8_t slot_pins[] = SLOT_PINS;
+#define SLOTS (sizeof(slot_pins)/sizeof(slot_pins[0]))
+
+static struct {
+    uint8_t valid;
+    uint8_t freq;
+    uint8_t mode;
+    uint8_t spcr;
+    uint16_t delay;
+} slots[SLOTS];
+
+static uint8_t slot;
+
+#define CS_PORT     SLOT_PORT
+#define CS_DDR      SLOT_DDR
+#define CS_MASK     _BV(slot_pins[slot])
+#else
+#define CS_PORT     SPI_PORT
+#define CS_DDR      SPI_DDR
+#define CS_MASK     _BV(SPI_CS)
+#endif
+
+struct isp_timing_t isp_timing;
+
+#ifdef ENABLE_GANG
+struct gang_state_t gang;
+
+/* miso samples of the last byte, msb first */
+static uint8_t gang_samples[8];
+
+/* returns the bitmap of gang devices which returned value in the last spi_send() */
+static uint8_t gang_equal(uint8_t value)
+{
+    uint8_t result = gang.mask;
+
+    for (uint8_t i = 0; i < 8; i++) {
+        if (value & _BV(7))
+            result &= gang_samples[i];
+        else
+            result &= ~gang_samples[i];
+        value <<= 1;
+    }
+
+    return result;
+}
+
+void isp_gang_verify(uint8_t data)
+{
+    if (spi.mode == GANG)
+        gang.failed |= gang.attached & ~gang_equal(data);
+}
+#endif
+
+/* returns true if polling is done, i.e. the byte just read is (equal) or is not
+ * (!equal) value, in gang mode for all attached devices */
+static bool isp_poll_done(uint8_t data, uint8_t value, bool equal)
+{
+    TELEMETRY_ADD(TELEMETRY_POLLS, 1);
+
+#ifdef ENABLE_GANG
+    if (spi.mode == GANG) {
+        uint8_t match = gang_equal(value) & gang.attached;
+        gang.busy = equal ? gang.attached & ~match : match;
+        return gang.busy == 0;
+    }
+#endif
+
+    return (data == value) == equal;
+}
+
+/* polling timed out */
+static void isp_poll_failed(void)
+{
+    TELEMETRY_ADD(TELEMETRY_POLL_TIMEOUTS, 1);
+#ifdef ENABLE_GANG
+    gang.failed |= gang.busy;
+#endif
+}
+
+/* address of the last byte loaded into the current flash page which is not 0xff,
+ * used for polling when the page is written */
+static struct {
+    uint16_t address;
+    uint8_t valid;
+} page_poll;
+
+/* write cycle of the device which has not been waited for yet, avr_finish()
+ * waits for it before the next instruction is sent, so that the usb transfers
+ * in between overlap with the write cycle */
+#define WRITE_NONE      0
+#define WRITE_EEPROM    1
+#define WRITE_FLASH     2   /* single byte, without page buffer */
+#define WRITE_PAGE      3
+
+static struct {
+    uint8_t type;
+    uint8_t poll;       /* address can be polled */
+    uint16_t address;
+    uint8_t data;       /* byte written */
+    uint32_t start;     /* timer_now() when the write cycle started */
+} pending;
+
+/* record the steps until a write cycle was done, the first ISP_TIMING_SAMPLES
+ * writes after attaching determine the learned value */
+static void isp_learn(uint8_t *learned, uint8_t *samples, uint32_t steps)
+{
+    if (*samples >= ISP_TIMING_SAMPLES)
+        return;
+
+    if (steps > UINT8_MAX)
+        steps = UINT8_MAX;
+    if (steps > *learned)
+        *learned = steps;
+    (*samples)++;
+}
+
+/* reset is active low, unless the family says otherwise */
+static void spi_reset(bool active)
+{
+    if (active == family->reset_high)
+        CS_PORT |= CS_MASK;
+    else
+        CS_PORT &= ~CS_MASK;
+}
+
 static void spi_device_reset(void)
 {
     /* set SCK low */
     SPI_PORT &= ~_BV(SPI_SCK);
 
     /* un-reset device, wait, reset device again */
-    SPI_PORT |= _BV(SPI_CS);
+    spi_reset(false);
     _delay_loop_2(spi.delay*2);
-    SPI_PORT &= ~_BV(SPI_CS);
+    spi_reset(true);
 }
 
-static uint8_t spi_magicbytes(void)
+/* returns true if the device has been put into programming mode */
+static bool spi_magicbytes(void)
 {
-    uint8_t echo;
+    static const uint8_t magic[] = { 0xAC, 0x53, 0, 0 };
+    uint8_t echo = 0;
 
     /* reset device */
     spi_device_reset();
 
-    /* send magic byte sequence */
-    spi_send(0xAC);
-    spi_send(0x53);
-    /* if everything works, the next bytes echoes 0x53 */
-    echo = spi_send(0);
-    spi_send(0);
+    /* send magic byte sequence, if everything works one byte echoes (0x53
+     * in the third one for avr devices) */
+    for (uint8_t i = 0; i < sizeof(magic); i++) {
+        uint8_t data = spi_send(magic[i]);
+
+        if (i == family->echo_index) {
+            echo = data;
+#ifdef ENABLE_GANG
+            if (spi.mode == GANG)
+                gang.attached = gang_equal(family->echo);
+#endif
+        }
+    }
 
-    return echo;
+    return echo == family->echo;
 }
 
 static void spi_enable_hardware(void)
@@ -89,20 +253,60 @@ static void spi_enable_hardware(void)
 void spi_enable(void)
 {
     /* configure MOSI, SCK and CS as output and MISO as input */
-    SPI_DDR |= _BV(SPI_MOSI) | _BV(SPI_SCK) | _BV(SPI_CS);
+    SPI_DDR |= _BV(SPI_MOSI) | _BV(SPI_SCK);
+    CS_DDR |= CS_MASK;
     SPI_DDR &= ~_BV(SPI_MISO);
 
-    /* set CS high, SCK and MOSI low and MISO pullup off */
-    SPI_PORT |= _BV(SPI_CS);
+    /* release reset, SCK and MOSI low and MISO pullup off */
+    spi_reset(false);
     SPI_PORT &= ~(_BV(SPI_MOSI) | _BV(SPI_SCK) | _BV(SPI_MISO));
 
+#ifdef ENABLE_MULTI_TARGET
+    /* keep all other devices out of reset */
+    for (uint8_t i = 0; i < SLOTS; i++) {
+        SLOT_DDR |= _BV(slot_pins[i]);
+        SLOT_PORT |= _BV(slot_pins[i]);
+    }
+#endif
+
     /* if CS pin is not on SS pin, enable pullup for SS pin */
-#if SPI_CS != SPI_SS
+#if defined(ENABLE_MULTI_TARGET) || SPI_CS != SPI_SS
     SPI_PORT |= _BV(SPI_SS);
 #endif
 
+#ifdef ENABLE_GANG
+    /* gang miso pins are inputs with pullups, so that missing devices read 0xff */
+    GANG_DDR &= ~GANG_MASK;
+    GANG_PORT |= GANG_MASK;
+#endif
+
     /* reset device */
-    SPI_PORT &= ~_BV(SPI_CS);
+    spi_reset(true);
+}
+
+void spi_hardware_prescaler(uint8_t prescaler)
+{
+    spi_enable_hardware();
+    SPCR = _BV(SPE) | _BV(MSTR) | (prescaler & (_BV(SPR0) | _BV(SPR1)));
+    spi.mode = HARDWARE;
+}
+
+void spi_release(void)
+{
+    spi_reset(false);
+}
+
+void spi_chip_select(bool select)
+{
+    if (select)
+        CS_PORT &= ~CS_MASK;
+    else
+        CS_PORT |= CS_MASK;
+}
+
+bool spi_miso(void)
+{
+    return SPI_PIN & _BV(SPI_MISO);
 }
 
 static void spi_disable_hardware(void)
@@ -116,10 +320,58 @@ void spi_disable(void)
     spi_disable_hardware();
 
     /* configure all pins as inputs */
-    SPI_DDR &= ~(_BV(SPI_MOSI) | _BV(SPI_SCK) | _BV(SPI_CS) | _BV(SPI_MISO));
-    SPI_PORT &= ~(_BV(SPI_MOSI) | _BV(SPI_SCK) | _BV(SPI_CS) | _BV(SPI_MISO));
+    SPI_DDR &= ~(_BV(SPI_MOSI) | _BV(SPI_SCK) | _BV(SPI_MISO));
+    SPI_PORT &= ~(_BV(SPI_MOSI) | _BV(SPI_SCK) | _BV(SPI_MISO));
+
+#ifdef ENABLE_MULTI_TARGET
+    for (uint8_t i = 0; i < SLOTS; i++) {
+        SLOT_DDR &= ~_BV(slot_pins[i]);
+        SLOT_PORT &= ~_BV(slot_pins[i]);
+    }
+#else
+    SPI_DDR &= ~_BV(SPI_CS);
+    SPI_PORT &= ~_BV(SPI_CS);
+#endif
+}
+
+#ifdef ENABLE_MULTI_TARGET
+bool spi_select(uint8_t target)
+{
+    if (target >= SLOTS)
+        return false;
+
+    /* if the pins are enabled, release the current device and reset the new one */
+    if (CS_DDR & CS_MASK) {
+        spi_reset(false);
+        slot = target;
+        spi_reset(true);
+    } else
+        slot = target;
+
+    return true;
 }
 
+/* try settings found by a previous isp_attach() for this slot */
+static bool isp_attach_slot(uint8_t freq)
+{
+    if (!slots[slot].valid || slots[slot].freq != freq)
+        return false;
+
+    spi.mode = slots[slot].mode;
+    spi.delay = slots[slot].delay;
+    SPCR = slots[slot].spcr;
+
+    for (uint8_t count = 0; count < SLOT_TRIES; count++) {
+        if (spi_magicbytes())
+            return true;
+        TELEMETRY_ADD(TELEMETRY_MAGIC_RETRIES, 1);
+    }
+
+    slots[slot].valid = 0;
+    return false;
+}
+#endif
+
 uint8_t spi_send(uint8_t data)
 {
     if (spi.mode == HARDWARE) {
@@ -140,6 +392,15 @@ uint8_t spi_send(uint8_t data)
 
             /* read data at MISO pin */
             recv <<= 1;
+#ifdef ENABLE_GANG
+            if (spi.mode == GANG) {
+                /* sample all devices at once, return data from the primary one */
+                uint8_t sample = GANG_PIN;
+                gang_samples[i] = sample;
+                if (sample & gang.primary)
+                    recv |= 1;
+            } else
+#endif
             if (SPI_PIN & _BV(SPI_MISO))
                 recv |= 1;
 
@@ -165,11 +426,12 @@ static bool isp_attach_hardware(void)
     /* try to connect with lowest spi frequency first */
     uint8_t count = SPI_MAX_TRIES_HW;
     do {
-        if (spi_magicbytes() == 0x53) {
+        if (spi_magicbytes()) {
             /* device has been put into programming mode */
             success = 1;
             break;
         }
+        TELEMETRY_ADD(TELEMETRY_MAGIC_RETRIES, 1);
     } while (--count);
 
     if (!success)
@@ -185,26 +447,25 @@ static bool isp_attach_hardware(void)
     for (uint8_t i = 0; i < 4; i++) {
         SPCR = _BV(SPE) | _BV(MSTR) | prescaler;
 
-        debug_putc(prescaler);
+        debug_event(DEBUG_PRESCALER, prescaler);
 
         /* test device */
-        if (spi_magicbytes() != 0x53) {
+        if (!spi_magicbytes()) {
             /* frequency too high, stop here */
             prescaler++;
             SPCR = _BV(SPE) | _BV(MSTR) | prescaler;
-            debug_putc('B');
+            debug_event(DEBUG_PRESCALER_FAILED, 0);
             break;
         }
 
         prescaler--;
     }
     /* test again, if this prescaler works */
-    if (spi_magicbytes() != 0x53)
+    if (!spi_magicbytes())
         /* device cannot be reached */
         return false;
 
-    debug_putc('b');
-    debug_putc(SPCR & (_BV(SPR0) | _BV(SPR1)));
+    debug_event(DEBUG_PRESCALER_FOUND, SPCR & (_BV(SPR0) | _BV(SPR1)));
 #endif
 
     return true;
@@ -215,94 +476,224 @@ static bool isp_attach_software(void)
 {
     /* try to connect */
     for (uint8_t count = 0; count < SPI_MAX_TRIES_SW; count++) {
-        if (spi_magicbytes() == 0x53) {
+        if (spi_magicbytes()) {
             /* device has been put into programming mode */
             return true;
         }
+        TELEMETRY_ADD(TELEMETRY_MAGIC_RETRIES, 1);
     }
 
     /* device does not react */
     return false;
 }
 
+/* software spi delay for a USBASP_ISP_SCK_* value */
+static uint16_t spi_sw_delay(uint8_t freq)
+{
+    /* find correct delay value:
+     * USBASP_ISP_SCK_AUTO   0
+     * USBASP_ISP_SCK_0_5    1    500 Hz
+     * USBASP_ISP_SCK_1      2      1 kHz
+     * USBASP_ISP_SCK_2      3      2 kHz
+     * USBASP_ISP_SCK_4      4      4 kHz
+     * USBASP_ISP_SCK_8      5      8 kHz
+     * USBASP_ISP_SCK_16     6     16 kHz
+     * USBASP_ISP_SCK_32     7     32 kHz
+     * USBASP_ISP_SCK_93_75  8     93.75 kHz
+     * USBASP_ISP_SCK_187_5  9    187.5  kHz
+     * USBASP_ISP_SCK_375    10   375 kHz
+     * USBASP_ISP_SCK_750    11   750 kHz
+     * USBASP_ISP_SCK_1500   12   1.5 MHz
+     */
+    switch (freq) {
+        case 1:     return F_CPU/4/500;
+        case 2:     return F_CPU/4/1000;
+        case 3:     return F_CPU/4/2000;
+        case 4:     return F_CPU/4/4000;
+        case 5:     return F_CPU/4/8000;
+        case 6:     return F_CPU/4/16000;
+        case 7:     return F_CPU/4/32000;
+        case 8:     return F_CPU/4/93750;
+        case 9:     return F_CPU/4/187500;
+        case 10:    return F_CPU/4/375000;
+        case 11:    return F_CPU/4/750000;
+        default:    return F_CPU/4/1500000;
+    }
+}
+
+#ifdef ENABLE_GANG
+/* returns true if at least one device has been put into programming mode, all
+ * devices share reset, so try until all of them react at the same time */
+static bool isp_attach_gang(void)
+{
+    for (uint8_t count = 0; count < SPI_MAX_TRIES_SW; count++) {
+        spi_magicbytes();
+        if (gang.attached == gang.mask)
+            break;
+    }
+
+    /* data returned by spi_send() is taken from the lowest attached device */
+    gang.primary = gang.attached & -gang.attached;
+    gang.failed = 0;
+    gang.busy = 0;
+
+    return gang.attached != 0;
+}
+#endif
+
 /* returns true if device has been put into programming mode, false otherwise */
-bool isp_attach(uint8_t freq)
+static bool isp_attach_search(uint8_t freq)
 {
+#ifdef ENABLE_GANG
+    if (gang.mask) {
+        debug_event(DEBUG_ATTACH_GANG, 0);
+
+        spi_disable_hardware();
+        spi.mode = GANG;
+        gang.primary = gang.mask & -gang.mask;
+        spi.delay = freq ? spi_sw_delay(freq) : DEFAULT_SPI_SW_DELAY;
+
+        if (isp_attach_gang())
+            return true;
+
+        TELEMETRY_ADD(TELEMETRY_ATTACH_FAILED_SW, 1);
+        return false;
+    }
+#endif
+
     if (freq == 0) {
         /* try auto */
-        debug_putc('A');
+        debug_event(DEBUG_ATTACH_AUTO, 0);
 
         /* try hardware (hardware is enabled and configured after call to this function) */
         spi_enable_hardware();
         spi.mode = HARDWARE;
-        debug_putc('H');
+        debug_event(DEBUG_ATTACH_HARDWARE, 0);
         if (isp_attach_hardware()) {
-            debug_putc('t');
+            debug_event(DEBUG_ATTACHED, 0);
             return true;
         }
 
+        TELEMETRY_ADD(TELEMETRY_ATTACH_FAILED_HW, 1);
+
         /* else disable hardware */
         spi_disable_hardware();
         spi.mode = SOFTWARE;
-        debug_putc('S');
+        debug_event(DEBUG_ATTACH_SOFTWARE, 0);
 
         /* and try software (with frequency F_CPU/4/150 =~ 26-33khz) */
         spi.delay = DEFAULT_SPI_SW_DELAY;
         if (isp_attach_software()) {
             spi.mode = SOFTWARE;
-            debug_putc('t');
+            debug_event(DEBUG_ATTACHED, 0);
             return true;
         }
     } else {
         /* manual spi, in software */
-        debug_putc('M');
-        debug_putc(freq);
+        debug_event(DEBUG_ATTACH_MANUAL, freq);
 
         spi_disable_hardware();
         spi.mode = SOFTWARE;
 
-        /* find correct delay value:
-         * USBASP_ISP_SCK_AUTO   0
-         * USBASP_ISP_SCK_0_5    1    500 Hz
-         * USBASP_ISP_SCK_1      2      1 kHz
-         * USBASP_ISP_SCK_2      3      2 kHz
-         * USBASP_ISP_SCK_4      4      4 kHz
-         * USBASP_ISP_SCK_8      5      8 kHz
-         * USBASP_ISP_SCK_16     6     16 kHz
-         * USBASP_ISP_SCK_32     7     32 kHz
-         * USBASP_ISP_SCK_93_75  8     93.75 kHz
-         * USBASP_ISP_SCK_187_5  9    187.5  kHz
-         * USBASP_ISP_SCK_375    10   375 kHz
-         * USBASP_ISP_SCK_750    11   750 kHz
-         * USBASP_ISP_SCK_1500   12   1.5 MHz
-         */
-        switch (freq) {
-            case 1:     spi.delay = F_CPU/4/500; break;
-            case 2:     spi.delay = F_CPU/4/1000; break;
-            case 3:     spi.delay = F_CPU/4/2000; break;
-            case 4:     spi.delay = F_CPU/4/4000; break;
-            case 5:     spi.delay = F_CPU/4/8000; break;
-            case 6:     spi.delay = F_CPU/4/16000; break;
-            case 7:     spi.delay = F_CPU/4/32000; break;
-            case 8:     spi.delay = F_CPU/4/93750; break;
-            case 9:     spi.delay = F_CPU/4/187500; break;
-            case 10:    spi.delay = F_CPU/4/375000; break;
-            case 11:    spi.delay = F_CPU/4/750000; break;
-            default:    spi.delay = F_CPU/4/1500000; break;
-        }
-        debug_putc(HI8(spi.delay));
-        debug_putc(LO8(spi.delay));
+        spi.delay = spi_sw_delay(freq);
 
         if (isp_attach_software()) {
             spi.mode = SOFTWARE;
-            debug_putc('t');
+            debug_event(DEBUG_ATTACHED, 0);
             return true;
         }
     }
 
+    TELEMETRY_ADD(TELEMETRY_ATTACH_FAILED_SW, 1);
     return 0;
 }
 
+/* returns true if the device has been put into programming mode, false otherwise */
+bool spi_attach(uint8_t freq)
+{
+#ifdef ENABLE_MULTI_TARGET
+    if (isp_attach_slot(freq)) {
+        debug_event(DEBUG_ATTACH_SLOT, 0);
+        return true;
+    }
+
+    if (!isp_attach_search(freq))
+        return false;
+
+    slots[slot].valid = 1;
+    slots[slot].freq = freq;
+    slots[slot].mode = spi.mode;
+    slots[slot].delay = spi.delay;
+    slots[slot].spcr = SPCR;
+
+    return true;
+#else
+    return isp_attach_search(freq);
+#endif
+}
+
+/* returns true if device has been put into programming mode, false otherwise */
+bool isp_attach(uint8_t freq)
+{
+    /* forget timing learned from a previous device */
+    isp_timing.flash_page = 0;
+    isp_timing.flash_page_samples = 0;
+    isp_timing.eeprom = 0;
+    isp_timing.eeprom_samples = 0;
+    page_poll.valid = 0;
+    pending.type = WRITE_NONE;
+
+    PROFILE_START(cycles);
+    bool ok = family->attach(freq);
+    PROFILE_STOP(PROFILE_ISP_ATTACH, cycles);
+
+#ifdef ENABLE_TELEMETRY
+    if (ok) {
+        TELEMETRY_ADD(TELEMETRY_ATTACHES, 1);
+        telemetry_sck = spi.mode == HARDWARE ?
+            TELEMETRY_HARDWARE | (SPCR & (_BV(SPR0) | _BV(SPR1))) : freq;
+    }
+#endif
+
+    return ok;
+}
+
+#if defined(ENABLE_AT89) || defined(ENABLE_I2C)
+bool isp_set_family(uint8_t id, uint16_t param)
+{
+    family = &avr_family;
+
+#ifdef ENABLE_AT89
+    if (id == ISP_FAMILY_AT89) {
+        at89_init(param);
+        family = &at89_family;
+    }
+#endif
+#ifdef ENABLE_I2C
+    if (id == ISP_FAMILY_I2C) {
+        if (!i2c_init(LO8(param) ? LO8(param) : 256, HI8(param)))
+            return false;
+        family = &i2c_family;
+    }
+#endif
+
+    return true;
+}
+#endif
+
+void isp_finish(void)
+{
+    family->finish();
+}
+
+uint8_t isp_command(uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4)
+{
+    spi_send(b1);
+    spi_send(b2);
+    spi_send(b3);
+    return spi_send(b4);
+}
+
 bool isp_busy(void)
 {
     spi_send(ISP_READY);
@@ -311,8 +702,63 @@ bool isp_busy(void)
     return (spi_send(0) & 1);
 }
 
+/* the byte counters only contain data actually transferred, polling reads
+ * through the family directly */
 uint8_t isp_read_flash(uint16_t address)
 {
+    TELEMETRY_ADD(TELEMETRY_FLASH_READ, 1);
+    return family->read(address, false);
+}
+
+uint8_t isp_read_eeprom(uint16_t address)
+{
+    TELEMETRY_ADD(TELEMETRY_EEPROM_READ, 1);
+    return family->read(address, true);
+}
+
+void isp_write_eeprom(uint16_t address, uint8_t data)
+{
+    TELEMETRY_ADD(TELEMETRY_EEPROM_WRITTEN, 1);
+    family->write(address, data, ISP_MEMORY_EEPROM);
+}
+
+void isp_write_flash_page(uint16_t address, uint8_t data, uint8_t poll)
+{
+    TELEMETRY_ADD(TELEMETRY_FLASH_WRITTEN, 1);
+    family->write(address, data, poll ? ISP_MEMORY_FLASH : ISP_MEMORY_PAGE);
+}
+
+void isp_start_flash_page(uint16_t address)
+{
+    family->write_page(address);
+}
+
+void isp_wait_flash_page(void)
+{
+    family->finish();
+}
+
+void isp_save_flash_page(uint16_t address)
+{
+    isp_start_flash_page(address);
+    isp_wait_flash_page();
+}
+
+static bool avr_attach(uint8_t freq)
+{
+    return spi_attach(freq);
+}
+
+/* read without waiting for a pending write cycle, used for polling */
+static uint8_t avr_load(uint16_t address, bool eeprom)
+{
+    if (eeprom) {
+        spi_send(ISP_READ_EEPROM);
+        spi_send(HI8(address));
+        spi_send(LO8(address));
+        return spi_send(0);
+    }
+
     /* send 0x20 if low byte is to be read,
      * send 0x28 if high byte is to be read */
     spi_send(ISP_READ_FLASH | (address & 1) << 3);
@@ -324,35 +770,73 @@ uint8_t isp_read_flash(uint16_t address)
     return spi_send(0);
 }
 
-uint8_t isp_read_eeprom(uint16_t address)
+static uint8_t avr_read(uint16_t address, bool eeprom)
 {
-    spi_send(ISP_READ_EEPROM);
-    spi_send(HI8(address));
-    spi_send(LO8(address));
-    return spi_send(0);
+    avr_finish();
+    return avr_load(address, eeprom);
 }
 
-void isp_write_eeprom(uint16_t address, uint8_t data)
+/* a write cycle has just been started */
+static void avr_write_started(uint8_t type, bool poll, uint16_t address, uint8_t data)
 {
-    spi_send(ISP_WRITE_EEPROM);
-    spi_send(HI8(address));
-    spi_send(LO8(address));
-    spi_send(data);
+    pending.type = type;
+    pending.poll = poll;
+    pending.address = address;
+    pending.data = data;
+    pending.start = timer_now();
+}
 
-    /* poll until byte has been written */
-    if (data == 0xff)
-        _delay_loop_2(EEPROM_TIMEOUT);
-    else {
-        for (uint8_t i = 0; i < EEPROM_POLL_TRIES; i++) {
-            if (isp_read_eeprom(address) == data)
-                break;
-            _delay_loop_2(EEPROM_POLL_TIMEOUT);
+/* poll the byte written until it is done (eeprom: it reads back, flash: it is
+ * not 0xff), otherwise wait the learned time plus 50% (at least one step more)
+ * or the worst case, counted from the start of the write cycle */
+static void avr_wait(uint8_t *learned, uint8_t *samples, uint32_t timeout)
+{
+    if (!pending.poll) {
+        if (samples && *samples)
+            timeout = *learned + *learned/2 + 1;
+        while (!timer_reached(pending.start + timeout))
+            ;
+        return;
+    }
+
+    for (bool busy = false;; busy = true) {
+        bool done;
+        if (pending.type == WRITE_EEPROM)
+            done = isp_poll_done(avr_load(pending.address, true), pending.data, true);
+        else
+            done = isp_poll_done(avr_load(pending.address, false), 0xff, false);
+
+        uint32_t steps = timer_now() - pending.start;
+        if (done) {
+            /* a write which was done at the first poll may have taken less */
+            if (busy && samples)
+                isp_learn(learned, samples, steps);
+            return;
+        }
+
+        if (steps >= timeout) {
+            isp_poll_failed();
+            return;
         }
     }
 }
 
-void isp_write_flash_page(uint16_t address, uint8_t data, uint8_t poll)
+static void avr_write(uint16_t address, uint8_t data, uint8_t memory)
 {
+    /* the page buffer cannot be loaded while the previous page is written */
+    avr_finish();
+
+    if (memory == ISP_MEMORY_EEPROM) {
+        spi_send(ISP_WRITE_EEPROM);
+        spi_send(HI8(address));
+        spi_send(LO8(address));
+        spi_send(data);
+
+        /* 0xff cannot be polled, it is the value read during the write cycle */
+        avr_write_started(WRITE_EEPROM, data != 0xff, address, data);
+        return;
+    }
+
     /* send 0x40 if low byte is to be written,
      * send 0x48 if high byte is to be written */
     spi_send(ISP_WRITE_FLASH | (address & 1) << 3);
@@ -363,23 +847,24 @@ void isp_write_flash_page(uint16_t address, uint8_t data, uint8_t poll)
     spi_send(LO8(word_address));
     spi_send(data);
 
-    if (!poll)
-        return;
-
-    if (data == 0xff)
-        /* just wait the maximum time */
-        _delay_loop_2(FLASH_TIMEOUT);
-    else {
-        for (uint8_t i = 0; i < FLASH_POLL_TRIES; i++) {
-            if (isp_read_flash(address) != 0xff)
-                break;
-            _delay_loop_2(FLASH_POLL_TIMEOUT);
+    if (memory == ISP_MEMORY_PAGE) {
+        /* remember a byte which can be polled when the page is saved */
+        if (data != 0xff) {
+            page_poll.address = address;
+            page_poll.valid = 1;
         }
+        return;
     }
+
+    avr_write_started(WRITE_FLASH, data != 0xff, address, data);
 }
 
-void isp_save_flash_page(uint16_t address)
+static void avr_write_page(uint16_t address)
 {
+    TELEMETRY_ADD(TELEMETRY_PAGES, 1);
+
+    avr_finish();
+
     spi_send(ISP_WRITE_PAGE);
 
     /* just send word address */
@@ -388,9 +873,31 @@ void isp_save_flash_page(uint16_t address)
     spi_send(LO8(address));
     spi_send(0);
 
-    for (uint8_t i = 0; i < FLASH_PAGE_POLL_TRIES; i++) {
-        if (isp_read_flash(address) != 0xff)
-            break;
-        _delay_loop_2(FLASH_PAGE_POLL_TIMEOUT);
+    /* reading from the page being written returns 0xff until it is done, a
+     * page containing only 0xff cannot be polled */
+    avr_write_started(WRITE_PAGE, page_poll.valid, page_poll.address, 0);
+    page_poll.valid = 0;
+}
+
+/* wait for a started write cycle */
+static void avr_finish(void)
+{
+    if (pending.type == WRITE_NONE)
+        return;
+
+    PROFILE_START(cycles);
+    if (pending.type == WRITE_EEPROM) {
+        avr_wait(&isp_timing.eeprom, &isp_timing.eeprom_samples,
+                TIMER_MS(EEPROM_WRITE_TIMEOUT_MS));
+        PROFILE_STOP(PROFILE_EEPROM_WAIT, cycles);
+    } else {
+        if (pending.type == WRITE_PAGE)
+            avr_wait(&isp_timing.flash_page, &isp_timing.flash_page_samples,
+                    TIMER_MS(FLASH_PAGE_TIMEOUT_MS));
+        else
+            avr_wait(NULL, NULL, TIMER_MS(FLASH_WRITE_TIMEOUT_MS));
+        PROFILE_STOP(PROFILE_FLASH_WAIT, cycles);
     }
+
+    pending.type = WRITE_NONE;
 }
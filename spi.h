@@ -31,9 +31,91 @@
 
 void spi_enable(void);
 void spi_disable(void);
+/* use hardware spi with prescaler (like SPR1:SPR0) */
+void spi_hardware_prescaler(uint8_t prescaler);
+/* release device from reset */
+void spi_release(void);
+bool spi_miso(void);
+/* drive CS low (select) or high, for devices other than avrs */
+void spi_chip_select(bool select);
+#ifdef ENABLE_MULTI_TARGET
+/* select target slot, returns false if the slot does not exist */
+bool spi_select(uint8_t target);
+#endif
 
 uint8_t spi_send(uint8_t data);
 
+/* find spi settings which put the device into programming mode (used by the
+ * attach of spi based families) */
+bool spi_attach(uint8_t freq);
+
+/* write cycle times learned from the first polled writes after isp_attach(),
+ * in timer steps (TIMER_STEP_CYCLES, 64us at 16MHz), saturating at 255 */
+struct isp_timing_t {
+    uint8_t flash_page;
+    uint8_t flash_page_samples;
+    uint8_t eeprom;
+    uint8_t eeprom_samples;
+};
+
+extern struct isp_timing_t isp_timing;
+
+#ifdef ENABLE_GANG
+/* gang programming state, bit n in each bitmap is pin n of GANG_PORTNAME */
+struct gang_state_t {
+    uint8_t mask;       /* devices to program, gang mode is off if 0 */
+    uint8_t attached;   /* devices in programming mode */
+    uint8_t primary;    /* device whose data is returned by spi_send() */
+    uint8_t busy;       /* devices which did not finish in the last poll */
+    uint8_t failed;     /* devices which timed out or returned different data */
+};
+
+extern struct gang_state_t gang;
+
+/* compare the byte just read from all attached devices with data returned by
+ * the primary one */
+void isp_gang_verify(uint8_t data);
+#endif
+
+/* target families, the instruction set used by the isp_* functions */
+#define ISP_FAMILY_AVR  0
+#define ISP_FAMILY_AT89 1
+#define ISP_FAMILY_I2C  2
+
+/* memory of a family write */
+#define ISP_MEMORY_PAGE     0   /* load into the flash page */
+#define ISP_MEMORY_FLASH    1   /* write a flash byte (byte mode) */
+#define ISP_MEMORY_EEPROM   2
+
+/* instruction set of a target family, the isp_* functions call the one
+ * selected by isp_set_family() */
+struct isp_family_t {
+    /* programming enable (0xac 0x53 0 0) after a reset pulse, byte
+     * echo_index of the answer is echo */
+    bool reset_high;
+    uint8_t echo_index;
+    uint8_t echo;
+
+    /* returns true if the device has been put into programming mode */
+    bool (*attach)(uint8_t freq);
+    uint8_t (*read)(uint16_t address, bool eeprom);
+    void (*write)(uint16_t address, uint8_t data, uint8_t memory);
+    /* start writing the loaded flash page */
+    void (*write_page)(uint16_t address);
+    /* complete pending transfers and wait for a started write */
+    void (*finish)(void);
+};
+
+#if defined(ENABLE_AT89) || defined(ENABLE_I2C)
+/* select the family for the next isp_attach(), param is the flash page size
+ * (at89) or the page size | address bytes << 8 (i2c, a page size of 0 is
+ * 256 bytes, 1 selects byte writes), returns false if param is invalid */
+bool isp_set_family(uint8_t family, uint16_t param);
+#endif
+/* complete pending page transfers and write cycles before sending raw
+ * instructions */
+void isp_finish(void);
+
 /* returns 0 if device has been put into programming mode, 1 otherwise */
 bool isp_attach(uint8_t freq);
 bool isp_busy(void);
@@ -42,5 +124,10 @@ uint8_t isp_read_eeprom(uint16_t address);
 void isp_write_eeprom(uint16_t address, uint8_t data);
 void isp_write_flash_page(uint16_t address, uint8_t data, uint8_t poll);
 void isp_save_flash_page(uint16_t address);
+/* isp_save_flash_page() in two steps, the device is busy in between */
+void isp_start_flash_page(uint16_t address);
+void isp_wait_flash_page(void);
+/* send a raw isp instruction, returns the last byte received */
+uint8_t isp_command(uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4);
 
 #endif
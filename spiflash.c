@@ -0,0 +1,192 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include "config.h"
+#include "spi.h"
+#include "spiflash.h"
+#include "timer.h"
+
+#ifdef ENABLE_SPIFLASH
+
+#define SPIFLASH_PROGRAM    0x02
+#define SPIFLASH_RDSR       0x05
+#define SPIFLASH_WREN       0x06
+#define SPIFLASH_FAST_READ  0x0b
+#define SPIFLASH_SE         0x20
+#define SPIFLASH_RDID       0x9f
+#define SPIFLASH_CE         0xc7
+#define SPIFLASH_BE         0xd8
+
+#define SPIFLASH_WIP        _BV(0)
+#define SPIFLASH_PAGESIZE   256
+
+static const uint8_t erase_commands[] = { SPIFLASH_SE, SPIFLASH_BE, SPIFLASH_CE };
+
+/* next address of the current write stream, and whether its page has been
+ * opened with a program command */
+static uint32_t write_address;
+static bool write_open;
+
+static void spiflash_select(uint8_t cmd)
+{
+    spi_chip_select(true);
+    spi_send(cmd);
+}
+
+static void spiflash_address(uint32_t address)
+{
+    spi_send(address >> 16);
+    spi_send(HI8(address));
+    spi_send(LO8(address));
+}
+
+uint8_t spiflash_status(void)
+{
+    spiflash_select(SPIFLASH_RDSR);
+    uint8_t status = spi_send(0);
+    spi_chip_select(false);
+
+    return status;
+}
+
+/* wait for a program cycle, erasing takes longer */
+static bool spiflash_wait(void)
+{
+    timer_t timeout;
+
+    timer_set(&timeout, SPIFLASH_TIMEOUT);
+    while (spiflash_status() & SPIFLASH_WIP) {
+        if (timer_expired(&timeout))
+            return false;
+    }
+
+    return true;
+}
+
+static bool spiflash_write_enable(void)
+{
+    if (!spiflash_wait())
+        return false;
+
+    spiflash_select(SPIFLASH_WREN);
+    spi_chip_select(false);
+
+    return true;
+}
+
+void spiflash_connect(uint8_t *id)
+{
+    spi_enable();
+    spi_chip_select(false);
+    spi_hardware_prescaler(SPIFLASH_PRESCALER);
+
+    spiflash_select(SPIFLASH_RDID);
+    for (uint8_t i = 0; i < 3; i++)
+        id[i] = spi_send(0);
+    spi_chip_select(false);
+}
+
+void spiflash_disconnect(void)
+{
+    spiflash_stop();
+    spi_disable();
+}
+
+bool spiflash_read_start(uint32_t address)
+{
+    spiflash_stop();
+    if (!spiflash_wait())
+        return false;
+
+    /* command, address and one dummy byte */
+    spiflash_select(SPIFLASH_FAST_READ);
+    spiflash_address(address);
+    spi_send(0);
+
+    return true;
+}
+
+uint8_t spiflash_read(void)
+{
+    return spi_send(0);
+}
+
+void spiflash_write_start(uint32_t address)
+{
+    spiflash_stop();
+
+    write_address = address;
+}
+
+bool spiflash_write(uint8_t data)
+{
+    /* open the page with the first byte written to it, so that a stream
+     * ending at a page boundary does not start an empty program cycle */
+    if (!write_open) {
+        if (!spiflash_write_enable())
+            return false;
+
+        spiflash_select(SPIFLASH_PROGRAM);
+        spiflash_address(write_address);
+        write_open = true;
+    }
+
+    spi_send(data);
+    write_address++;
+
+    /* program this page */
+    if ((write_address & (SPIFLASH_PAGESIZE-1)) == 0)
+        spiflash_stop();
+
+    return true;
+}
+
+void spiflash_stop(void)
+{
+    spi_chip_select(false);
+    write_open = false;
+}
+
+bool spiflash_erase(uint8_t type, uint32_t address)
+{
+    if (type >= sizeof(erase_commands))
+        return false;
+
+    spiflash_stop();
+    if (!spiflash_write_enable())
+        return false;
+
+    spiflash_select(erase_commands[type]);
+    if (type != SPIFLASH_ERASE_CHIP)
+        spiflash_address(address);
+    spi_chip_select(false);
+
+    return true;
+}
+
+#endif
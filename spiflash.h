@@ -0,0 +1,66 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __SPIFLASH_H
+#define __SPIFLASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* 25-series spi nor flash on the isp header (CS instead of reset), with
+ * hardware spi at full speed, 3 byte addresses and 256 byte pages
+ *
+ * a program cycle is waited for (at most SPIFLASH_TIMEOUT), an erase is not:
+ * after spiflash_erase() the caller has to poll spiflash_status() until WIP
+ * is clear, the other functions return false while the erase runs */
+
+/* erase types */
+#define SPIFLASH_ERASE_SECTOR   0   /* 4KiB */
+#define SPIFLASH_ERASE_BLOCK    1   /* 64KiB */
+#define SPIFLASH_ERASE_CHIP     2
+
+/* enable pins and read the jedec id (manufacturer, type, capacity) */
+void spiflash_connect(uint8_t *id);
+void spiflash_disconnect(void);
+
+/* fast read with a single chip select until spiflash_stop(), returns false
+ * if the flash is busy */
+bool spiflash_read_start(uint32_t address);
+uint8_t spiflash_read(void);
+
+/* page program, page boundaries are handled internally: a page is opened by
+ * the first byte written to it and programmed at its end or by
+ * spiflash_stop(), spiflash_write() returns false if the flash is busy */
+void spiflash_write_start(uint32_t address);
+bool spiflash_write(uint8_t data);
+
+void spiflash_stop(void);
+
+/* start erasing, poll spiflash_status() for WIP (bit 0), returns false if
+ * the flash is busy or the type unknown */
+bool spiflash_erase(uint8_t type, uint32_t address);
+uint8_t spiflash_status(void);
+
+#endif
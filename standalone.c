@@ -0,0 +1,317 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <util/delay.h>
+#include "config.h"
+#include "spi.h"
+#include "storage.h"
+#include "patch.h"
+#include "standalone.h"
+#include "timer.h"
+#include "usb.h"
+#include "debug.h"
+#include "telemetry.h"
+
+#ifdef ENABLE_STANDALONE
+
+/* isp instructions for fuses and lock bits (low, high, extended, lock) */
+static const uint8_t fuse_write[] = { 0xa0, 0xa8, 0xa4, 0xe0 };
+static const uint8_t fuse_read[][2] = {
+    { 0x50, 0x00 }, { 0x58, 0x08 }, { 0x50, 0x08 }, { 0x58, 0x00 },
+};
+
+static uint8_t page[STANDALONE_MAX_PAGESIZE];
+static uint8_t result = STANDALONE_NONE;
+
+static bool pending;
+
+static struct {
+    timer_t debounce;
+    uint8_t state;
+} button;
+
+static void read_page(uint16_t size)
+{
+    for (uint16_t i = 0; i < size; i++)
+        page[i] = storage_read();
+}
+
+static uint8_t program_flash(struct standalone_header_t *header)
+{
+    uint16_t address = 0;
+
+    if (!storage_read_start(STANDALONE_DATA))
+        return STANDALONE_ERR_STORAGE;
+    read_page(header->pagesize);
+
+    for (uint16_t n = 0; n < header->pages; n++) {
+        bool blank = true;
+        for (uint16_t i = 0; i < header->pagesize; i++) {
+#ifdef ENABLE_PATCH
+            page[i] = patch_apply(0, address + i, page[i]);
+#endif
+            if (page[i] != 0xff) {
+                blank = false;
+#ifndef ENABLE_PATCH
+                break;
+#endif
+            }
+        }
+
+        /* the device has just been erased, skip empty pages */
+        if (!blank) {
+            for (uint16_t i = 0; i < header->pagesize; i++)
+                isp_write_flash_page(address + i, page[i], 0);
+            isp_start_flash_page(address);
+        }
+
+        /* read ahead while the device writes the page */
+        if (n+1 < header->pages)
+            read_page(header->pagesize);
+
+        if (!blank)
+            isp_wait_flash_page();
+
+        address += header->pagesize;
+        usb_poll();
+    }
+
+    /* the eeprom contents follow the flash pages, skip erased bytes like
+     * the empty flash pages */
+    for (uint16_t i = 0; i < header->eeprom_size; i++) {
+        uint8_t data = storage_read();
+#ifdef ENABLE_PATCH
+        data = patch_apply(PATCH_EEPROM, i, data);
+#endif
+        if (data != 0xff)
+            isp_write_eeprom(i, data);
+        usb_poll();
+    }
+
+    storage_stop();
+
+    return STANDALONE_OK;
+}
+
+static uint8_t verify(struct standalone_header_t *header)
+{
+    uint32_t size = (uint32_t)header->pages * header->pagesize;
+    uint8_t ret = STANDALONE_OK;
+
+    if (!storage_read_start(STANDALONE_DATA))
+        return STANDALONE_ERR_STORAGE;
+
+    for (uint32_t address = 0; address < size; address++) {
+        uint8_t data = isp_read_flash(address);
+        uint8_t expected = storage_read();
+#ifdef ENABLE_GANG
+        isp_gang_verify(data);
+#endif
+#ifdef ENABLE_PATCH
+        expected = patch_apply(0, address, expected);
+#endif
+        if (data != expected) {
+            ret = STANDALONE_ERR_FLASH;
+            goto out;
+        }
+        if ((address & 15) == 15)
+            usb_poll();
+    }
+
+    for (uint16_t address = 0; address < header->eeprom_size; address++) {
+        uint8_t data = isp_read_eeprom(address);
+        uint8_t expected = storage_read();
+#ifdef ENABLE_GANG
+        isp_gang_verify(data);
+#endif
+#ifdef ENABLE_PATCH
+        expected = patch_apply(PATCH_EEPROM, address, expected);
+#endif
+        if (data != expected) {
+            ret = STANDALONE_ERR_EEPROM;
+            goto out;
+        }
+        if ((address & 15) == 15)
+            usb_poll();
+    }
+
+#ifdef ENABLE_GANG
+    if (gang.failed)
+        ret = STANDALONE_ERR_GANG;
+#endif
+
+out:
+    storage_stop();
+    return ret;
+}
+
+static uint8_t program_fuses(struct standalone_header_t *header)
+{
+    for (uint8_t i = 0; i < sizeof(header->fuses); i++) {
+        if (!(header->flags & _BV(i)))
+            continue;
+
+        isp_command(0xac, fuse_write[i], 0, header->fuses[i]);
+        _delay_loop_2(EEPROM_TIMEOUT);
+
+        if (isp_command(fuse_read[i][0], fuse_read[i][1], 0, 0) != header->fuses[i])
+            return STANDALONE_ERR_FUSES;
+        usb_poll();
+    }
+
+    return STANDALONE_OK;
+}
+
+static uint8_t run(void)
+{
+    struct standalone_header_t header;
+    uint8_t *p = (uint8_t *)&header;
+
+    if (!storage_read_start(0))
+        return STANDALONE_ERR_STORAGE;
+    for (uint8_t i = 0; i < sizeof(header); i++)
+        *p++ = storage_read();
+    storage_stop();
+
+    if (header.magic != STANDALONE_MAGIC || header.pagesize == 0
+            || header.pagesize > STANDALONE_MAX_PAGESIZE)
+        return STANDALONE_ERR_IMAGE;
+
+    if (!isp_attach(0))
+        return STANDALONE_ERR_ATTACH;
+
+    if (header.flags & STANDALONE_FLAG_SIGNATURE) {
+        for (uint8_t i = 0; i < sizeof(header.signature); i++) {
+            if (isp_command(0x30, 0, i, 0) != header.signature[i])
+                return STANDALONE_ERR_SIGNATURE;
+        }
+    }
+
+    /* chip erase, enter programming mode again afterwards */
+    isp_command(0xac, 0x80, 0, 0);
+    _delay_loop_2(CHIP_ERASE_TIMEOUT);
+    usb_poll();
+    if (!isp_attach(0))
+        return STANDALONE_ERR_ATTACH;
+
+    uint8_t ret = program_flash(&header);
+    if (ret == STANDALONE_OK)
+        ret = verify(&header);
+    if (ret == STANDALONE_OK)
+        ret = program_fuses(&header);
+
+    return ret;
+}
+
+uint8_t standalone_program(void)
+{
+    debug_event(DEBUG_STANDALONE_START, 0);
+
+    LED1_ON();
+    LED2_OFF();
+
+    /* usb requests are refused until the run is done */
+    result = STANDALONE_BUSY;
+    spi_enable();
+#ifdef ENABLE_PATCH
+    patch_enable(true);
+#endif
+    result = run();
+    spi_disable();
+
+#ifdef ENABLE_TELEMETRY_LIFETIME
+    telemetry_save();
+#endif
+
+    if (result == STANDALONE_OK) {
+#ifdef ENABLE_PATCH
+        /* verify() has checked the patched bytes */
+        patch_next();
+#endif
+        LED1_OFF();
+        LED2_ON();
+    }
+#ifdef ENABLE_PATCH
+    patch_enable(false);
+#endif
+
+    debug_event(DEBUG_STANDALONE_RESULT, result);
+
+    return result;
+}
+
+uint8_t standalone_result(void)
+{
+    return result;
+}
+
+void standalone_init(void)
+{
+    /* button input with pullup */
+    BUTTON_DDR &= ~_BV(BUTTON_PIN);
+    BUTTON_PORT |= _BV(BUTTON_PIN);
+
+    /* a missing storage is reported when programming */
+    storage_init();
+
+#ifdef STANDALONE_AUTOSTART
+    standalone_program();
+#endif
+}
+
+void standalone_start(void)
+{
+    result = STANDALONE_NONE;
+    pending = true;
+}
+
+void standalone_poll(void)
+{
+    if (pending) {
+        pending = false;
+        standalone_program();
+    }
+
+    /* button released */
+    if (BUTTON_INPUT & _BV(BUTTON_PIN)) {
+        button.state = 0;
+        return;
+    }
+
+    if (button.state == 0) {
+        /* debounce for 20ms */
+        timer_set(&button.debounce, 20);
+        button.state = 1;
+    } else if (button.state == 1 && timer_expired(&button.debounce)) {
+        /* program once per press */
+        button.state = 2;
+        standalone_program();
+    }
+}
+
+#endif
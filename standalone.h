@@ -0,0 +1,76 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __STANDALONE_H
+#define __STANDALONE_H
+
+#include <stdint.h>
+
+/* standalone programming: the image is uploaded to the external storage once
+ * (see storage.h), it starts with this header, followed by the flash pages
+ * at STANDALONE_DATA and the eeprom contents directly after them */
+struct standalone_header_t {
+    uint16_t magic;
+    uint8_t flags;
+    uint8_t signature[3];
+    uint16_t pagesize;
+    uint16_t pages;
+    uint16_t eeprom_size;
+    uint8_t fuses[4];       /* low, high, extended, lock */
+};
+
+#define STANDALONE_MAGIC    0x6b31
+#define STANDALONE_DATA     32
+
+/* flags, bits 0-3 select the fuses to be written */
+#define STANDALONE_FLAG_SIGNATURE   _BV(4)
+
+/* results */
+#define STANDALONE_OK               0
+#define STANDALONE_ERR_IMAGE        1
+#define STANDALONE_ERR_ATTACH       2
+#define STANDALONE_ERR_SIGNATURE    3
+#define STANDALONE_ERR_FLASH        4
+#define STANDALONE_ERR_EEPROM       5
+#define STANDALONE_ERR_FUSES        6
+#define STANDALONE_ERR_GANG         7
+#define STANDALONE_ERR_STORAGE      8   /* storage busy or missing */
+#define STANDALONE_BUSY             0xfe   /* run in progress */
+#define STANDALONE_NONE             0xff
+
+/* configure storage and button, programs the device if STANDALONE_AUTOSTART is set */
+void standalone_init(void);
+/* program on the next standalone_poll() (e.g. from a usb request) */
+void standalone_start(void);
+/* call regularly, starts programming when the button is pressed */
+void standalone_poll(void);
+/* program and verify the device, LED2 indicates success, LED1 failure, usb
+ * is polled between pages */
+uint8_t standalone_program(void);
+/* result of the last run, STANDALONE_NONE if there was none and
+ * STANDALONE_BUSY while programming */
+uint8_t standalone_result(void);
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include "config.h"
+#include "storage.h"
+#include "timer.h"
+
+#ifdef ENABLE_STANDALONE
+
+#define STORAGE_WRSR    0x01
+#define STORAGE_PROGRAM 0x02
+#define STORAGE_READ    0x03
+#define STORAGE_RDSR    0x05
+#define STORAGE_WREN    0x06
+#define STORAGE_ERASE   0x20
+
+/* next address of the current write stream */
+static uint32_t write_address;
+
+/* bit-banged spi, mode 0, as fast as possible */
+static uint8_t storage_send(uint8_t data)
+{
+    for (uint8_t i = 0; i < 8; i++) {
+        if (data & _BV(7))
+            STORAGE_PORT |= _BV(STORAGE_MOSI);
+        else
+            STORAGE_PORT &= ~_BV(STORAGE_MOSI);
+
+        data <<= 1;
+        if (STORAGE_PIN & _BV(STORAGE_MISO))
+            data |= 1;
+
+        STORAGE_PORT |= _BV(STORAGE_SCK);
+        STORAGE_PORT &= ~_BV(STORAGE_SCK);
+    }
+
+    return data;
+}
+
+static void storage_select(uint8_t cmd)
+{
+    STORAGE_PORT &= ~_BV(STORAGE_CS);
+    storage_send(cmd);
+}
+
+static void storage_deselect(void)
+{
+    STORAGE_PORT |= _BV(STORAGE_CS);
+}
+
+static void storage_address(uint32_t address)
+{
+#if STORAGE_ADDRESS_BYTES > 2
+    storage_send(address >> 16);
+#endif
+    storage_send(HI8(address));
+    storage_send(LO8(address));
+}
+
+uint8_t storage_status(void)
+{
+    storage_select(STORAGE_RDSR);
+    uint8_t status = storage_send(0);
+    storage_deselect();
+
+    return status;
+}
+
+/* wait for a program cycle, an erase or a missing chip take longer */
+static bool storage_wait(void)
+{
+    timer_t timeout;
+
+    timer_set(&timeout, STORAGE_TIMEOUT);
+    while (storage_status() & STORAGE_WIP) {
+        if (timer_expired(&timeout))
+            return false;
+    }
+
+    return true;
+}
+
+static bool storage_write_enable(void)
+{
+    if (!storage_wait())
+        return false;
+
+    storage_select(STORAGE_WREN);
+    storage_deselect();
+
+    return true;
+}
+
+bool storage_init(void)
+{
+    STORAGE_PORT |= _BV(STORAGE_CS);
+    STORAGE_DDR |= _BV(STORAGE_CS) | _BV(STORAGE_SCK) | _BV(STORAGE_MOSI);
+    STORAGE_DDR &= ~_BV(STORAGE_MISO);
+    STORAGE_PORT &= ~(_BV(STORAGE_SCK) | _BV(STORAGE_MOSI));
+    /* pull-up, so that a missing chip does not look idle */
+    STORAGE_PORT |= _BV(STORAGE_MISO);
+
+    /* remove block protection */
+    if (!storage_write_enable())
+        return false;
+
+    storage_select(STORAGE_WRSR);
+    storage_send(0);
+    storage_deselect();
+
+    return true;
+}
+
+bool storage_read_start(uint32_t address)
+{
+    storage_stop();
+    if (!storage_wait())
+        return false;
+
+    storage_select(STORAGE_READ);
+    storage_address(address);
+
+    return true;
+}
+
+uint8_t storage_read(void)
+{
+    return storage_send(0);
+}
+
+bool storage_write_start(uint32_t address)
+{
+    storage_stop();
+
+    write_address = address;
+
+    if (!storage_write_enable())
+        return false;
+
+    storage_select(STORAGE_PROGRAM);
+    storage_address(address);
+
+    return true;
+}
+
+bool storage_write(uint8_t data)
+{
+    storage_send(data);
+    write_address++;
+
+    /* program this page and continue with the next one */
+    if ((write_address & (STORAGE_PAGESIZE-1)) == 0) {
+        storage_deselect();
+        if (!storage_write_enable())
+            return false;
+
+        storage_select(STORAGE_PROGRAM);
+        storage_address(write_address);
+    }
+
+    return true;
+}
+
+void storage_stop(void)
+{
+    storage_deselect();
+}
+
+bool storage_erase(uint32_t address)
+{
+    storage_stop();
+#ifdef STORAGE_EEPROM
+    /* nothing to erase, but report a busy or missing chip */
+    return storage_wait();
+#else
+    if (!storage_write_enable())
+        return false;
+
+    storage_select(STORAGE_ERASE);
+    storage_address(address);
+    storage_deselect();
+
+    return true;
+#endif
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __STORAGE_H
+#define __STORAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* external 25-series spi flash or eeprom on the STORAGE_* pins, accessed in
+ * streams: start a read or write at an address, transfer bytes sequentially
+ * and end the stream with storage_stop()
+ *
+ * a program cycle is waited for (at most STORAGE_TIMEOUT), an erase is
+ * not: the functions return false while the chip is busy, poll
+ * storage_status() instead.  MISO has a pull-up, a missing chip is always
+ * busy and its status reads 0xff */
+
+#define STORAGE_WIP     _BV(0)
+
+/* returns false if no chip responds */
+bool storage_init(void);
+
+/* returns false if the chip is busy or missing */
+bool storage_read_start(uint32_t address);
+uint8_t storage_read(void);
+
+/* page boundaries are handled internally, both return false if the chip is
+ * busy or missing */
+bool storage_write_start(uint32_t address);
+bool storage_write(uint8_t data);
+
+void storage_stop(void);
+
+/* start erasing the sector containing address (does nothing for
+ * STORAGE_EEPROM), returns false if the chip is busy or missing */
+bool storage_erase(uint32_t address);
+uint8_t storage_status(void);
+
+#endif
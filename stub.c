@@ -0,0 +1,292 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "config.h"
+#include "spi.h"
+#include "stub.h"
+#include "debug.h"
+#include "timer.h"
+
+#ifdef ENABLE_LOADER_STUB
+
+/* generated by the Makefile from stubs/loader.S */
+#include "stub_images.h"
+
+struct stub_image_t {
+    const uint8_t *data;
+    uint16_t size;
+};
+
+/* older avr-libc versions only have pgm_read_word() */
+#ifndef pgm_read_ptr
+#define pgm_read_ptr(addr)  ((void *)pgm_read_word(addr))
+#endif
+
+#define STUB_IMAGE(image) { image, sizeof(image) },
+static const struct stub_image_t stub_images[] PROGMEM = { STUB_IMAGES };
+
+#define STUB_CMD_PAGE   'P'
+#define STUB_CMD_EXIT   'X'
+#define STUB_CMD_CRC    'C'
+#define STUB_CMD_SYNC   'S'
+
+/* sent by the stub while it receives a command byte and before the checksum */
+#define STUB_ACK        0xa5
+
+/* operations which are completed by stub_status() */
+#define STUB_NONE       0
+#define STUB_LOADING    1
+#define STUB_STARTING   2
+#define STUB_CHECKSUM   3
+#define STUB_EXITING    4
+
+static struct {
+    uint16_t last;      /* address of the last page of the stub in the target */
+    uint16_t pagesize;
+    uint16_t count;     /* bytes sent for the current page, 0 if no page is open */
+    uint8_t pages;      /* pages of the stub */
+    const uint8_t *image;
+    uint16_t size;
+    uint16_t address;   /* of the first page */
+    uint16_t loaded;    /* bytes of the image written */
+    uint8_t running;
+    uint8_t pending;    /* operation in progress */
+    uint8_t result;     /* of the last operation */
+    uint8_t freq;       /* for entering programming mode after exiting */
+    uint16_t crc;
+    timer_t timer;      /* deadline of the pending operation */
+} stub;
+
+/* wait until the stub signals ready on MISO, at most STUB_READY_TIMEOUT so
+ * that this can be called from usb callbacks */
+static bool stub_wait(void)
+{
+    timer_t t;
+
+    timer_set(&t, STUB_READY_TIMEOUT);
+    while (!spi_miso()) {
+        if (timer_expired(&t))
+            return false;
+    }
+
+    return true;
+}
+
+/* the stub pulls MISO low right after acknowledging the command byte, so a
+ * following stub_wait() does not see the ready level of this command */
+static bool stub_command(uint8_t cmd, uint16_t address)
+{
+    if (!stub_wait() || spi_send(cmd) != STUB_ACK)
+        return false;
+
+    spi_send(HI8(address));
+    spi_send(LO8(address));
+
+    return true;
+}
+
+/* start an operation polled by stub_status() */
+static void stub_pending(uint8_t operation, bool ok, uint16_t timeout)
+{
+    stub.pending = ok ? operation : STUB_NONE;
+    stub.result = ok ? STUB_DONE : STUB_FAILED;
+    timer_set(&stub.timer, timeout);
+}
+
+uint16_t stub_load(uint8_t image, uint16_t address)
+{
+    stub.pagesize = 0;
+
+    if (image >= sizeof(stub_images)/sizeof(stub_images[0]))
+        return 0;
+
+    stub.image = pgm_read_ptr(&stub_images[image].data);
+    stub.size = pgm_read_word(&stub_images[image].size);
+    stub.address = address;
+    stub.loaded = 0;
+
+    /* the last word of the image is the page size of the target */
+    stub.pagesize = pgm_read_word(stub.image + stub.size - 2);
+    stub.last = address + ((stub.size-1) & ~(stub.pagesize-1));
+    stub.pages = (stub.size + stub.pagesize-1) / stub.pagesize;
+
+    stub_pending(STUB_LOADING, true, 0);
+
+    return stub.pagesize;
+}
+
+/* write the next part of the image, returns true when done */
+static bool stub_load_next(void)
+{
+    for (uint8_t i = 0; i < STUB_LOAD_BYTES && stub.loaded < stub.size; i++) {
+        uint16_t address = stub.address + stub.loaded;
+
+        isp_write_flash_page(address, pgm_read_byte(stub.image + stub.loaded), 0);
+        stub.loaded++;
+
+        if ((stub.loaded & (stub.pagesize-1)) == 0 || stub.loaded == stub.size)
+            isp_save_flash_page(address);
+    }
+
+    return stub.loaded == stub.size;
+}
+
+bool stub_start(uint8_t prescaler)
+{
+    debug_event(DEBUG_STUB_START, prescaler);
+
+    if (stub.pagesize == 0 || stub.loaded != stub.size)
+        return false;
+
+    spi_hardware_prescaler(prescaler);
+    spi_release();
+
+    stub.count = 0;
+    stub.running = 0;
+
+    /* clocking bytes before the stub runs would leave it out of step with
+     * the bytes, so stub_status() waits for the device to start up */
+    stub_pending(STUB_STARTING, true, STUB_START_TIMEOUT);
+
+    return true;
+}
+
+bool stub_finish(uint8_t freq)
+{
+    debug_event(DEBUG_STUB_FINISH, freq);
+
+    stub_flush();
+    bool ok = stub.running && stub_command(STUB_CMD_EXIT, stub.last);
+
+    /* the stub does not signal ready after erasing itself, wait for the erase
+     * of each page */
+    stub.running = 0;
+    stub.freq = freq;
+    stub.pending = STUB_EXITING;
+    stub.result = ok ? STUB_DONE : STUB_FAILED;
+    timer_set(&stub.timer, ok ? stub.pages * STUB_ERASE_TIMEOUT : 0);
+
+    return ok;
+}
+
+bool stub_running(void)
+{
+    return stub.running;
+}
+
+bool stub_write(uint16_t address, uint8_t data)
+{
+    /* start a new page, pad up to address */
+    if (stub.count == 0) {
+        uint16_t offset = address & (stub.pagesize-1);
+
+        if (!stub_command(STUB_CMD_PAGE, address - offset))
+            return false;
+
+        while (stub.count < offset) {
+            spi_send(0xff);
+            stub.count++;
+        }
+    }
+
+    spi_send(data);
+
+    if (++stub.count == stub.pagesize)
+        stub.count = 0;
+
+    return true;
+}
+
+bool stub_crc(uint16_t end)
+{
+    stub_flush();
+
+    bool ok = stub.running && stub_command(STUB_CMD_CRC, end);
+
+    /* this takes about 70 target cycles per byte */
+    stub_pending(STUB_CHECKSUM, ok, STUB_CRC_TIMEOUT);
+
+    return ok;
+}
+
+uint8_t stub_status(uint16_t *crc)
+{
+    /* checked once, before the pending operation is polled */
+    bool expired = timer_expired(&stub.timer);
+
+    if (stub.pending == STUB_LOADING) {
+        if (stub_load_next())
+            stub.pending = STUB_NONE;
+    } else if (stub.pending == STUB_STARTING && expired) {
+        /* an idle MISO line is high as well, only an acknowledged command
+         * shows that the stub is running */
+        stub.running = stub_command(STUB_CMD_SYNC, 0);
+        if (!stub.running)
+            stub.result = STUB_FAILED;
+        stub.pending = STUB_NONE;
+    } else if (stub.pending == STUB_CHECKSUM && spi_miso()) {
+        /* the stub acknowledges the first byte, then sends the checksum */
+        if (spi_send(0) == STUB_ACK) {
+            stub.crc = spi_send(0) << 8;
+            stub.crc |= spi_send(0);
+        } else {
+            stub.running = 0;
+            stub.result = STUB_FAILED;
+        }
+        stub.pending = STUB_NONE;
+    } else if (stub.pending == STUB_EXITING && expired) {
+        /* reset device and enter programming mode again */
+        if (!isp_attach(stub.freq))
+            stub.result = STUB_FAILED;
+        stub.pending = STUB_NONE;
+    } else if (stub.pending != STUB_NONE && expired) {
+        /* the state of the stub is unknown, only stub_finish() is useful */
+        stub.running = 0;
+        stub.result = STUB_FAILED;
+        stub.pending = STUB_NONE;
+    }
+
+    *crc = stub.crc;
+
+    return stub.pending != STUB_NONE ? STUB_BUSY : stub.result;
+}
+
+void stub_flush(void)
+{
+    if (stub.count == 0)
+        return;
+
+    while (stub.count < stub.pagesize) {
+        spi_send(0xff);
+        stub.count++;
+    }
+    stub.count = 0;
+}
+
+#endif
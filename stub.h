@@ -0,0 +1,75 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __STUB_H
+#define __STUB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* high speed programming via a loader stub in the boot section of the target
+ * (see stubs/loader.S), the device must be in programming mode for
+ * stub_load() and the BOOTRST fuse must be programmed by the host before
+ * calling stub_start()
+ *
+ * loading, starting, checksumming and finishing take longer than a usb
+ * callback may run, they are only started by the functions below and
+ * completed by polling stub_status() */
+
+/* results of stub_status() */
+#define STUB_DONE       0
+#define STUB_FAILED     1
+#define STUB_BUSY       2
+
+/* write stub image to the boot section at address, returns the page size of
+ * the image or 0 if the image does not exist */
+uint16_t stub_load(uint8_t image, uint16_t address);
+/* release the device from reset, prescaler selects the spi speed for talking
+ * to the stub (like SPR1:SPR0), the target clock must be at least 32 times
+ * the sck frequency.  returns false if no stub has been loaded completely,
+ * the stub is running if it acknowledges a command after the device started */
+bool stub_start(uint8_t prescaler);
+/* let the stub erase itself, then put the device back into programming mode,
+ * returns false if the stub did not take the command (the device is reset
+ * anyway) */
+bool stub_finish(uint8_t freq);
+bool stub_running(void);
+
+/* program a byte via the stub, pages are padded with 0xff, returns false if
+ * the stub did not acknowledge a page */
+bool stub_write(uint16_t address, uint8_t data);
+/* pad and write an incomplete page */
+void stub_flush(void);
+
+/* let the stub checksum the flash below end (0 for 64KiB), crc16 with
+ * polynomial 0xa001 and initial value 0xffff, returns false if the stub did
+ * not take the command */
+bool stub_crc(uint16_t end);
+
+/* completes the operation started last, returns STUB_BUSY until it is done,
+ * crc is the last checksum */
+uint8_t stub_status(uint16_t *crc);
+
+#endif
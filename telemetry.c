@@ -0,0 +1,103 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/eeprom.h>
+#include "config.h"
+#include "telemetry.h"
+#include "usb.h"
+
+#ifdef ENABLE_TELEMETRY
+
+uint32_t telemetry[TELEMETRY_COUNTERS];
+uint8_t telemetry_sck;
+
+#ifdef ENABLE_TELEMETRY_LIFETIME
+/* lifetime counters up to this power cycle */
+static uint32_t stored[TELEMETRY_COUNTERS];
+
+/* sums taken by telemetry_save(), the counters keep changing while they are
+ * written byte by byte */
+static uint32_t saving[TELEMETRY_COUNTERS];
+
+/* next byte to be compared with the eeprom, TELEMETRY_COUNTERS*4 when idle */
+static uint8_t save_offset = TELEMETRY_COUNTERS*4;
+
+void telemetry_save(void)
+{
+    for (uint8_t i = 0; i < TELEMETRY_COUNTERS; i++)
+        saving[i] = stored[i] + telemetry[i];
+    save_offset = 0;
+}
+
+void telemetry_poll(void)
+{
+    /* one byte per call, so that usb_poll() is not blocked by the 8.5ms
+     * eeprom write cycles, unchanged bytes are not written at all */
+    while (save_offset < TELEMETRY_COUNTERS*4 && eeprom_is_ready()) {
+        uint8_t *p = (uint8_t *)eeprom_storage.telemetry + save_offset;
+        uint8_t data = ((uint8_t *)saving)[save_offset++];
+
+        if (eeprom_read_byte(p) != data) {
+            eeprom_write_byte(p, data);
+            break;
+        }
+    }
+}
+#endif
+
+void telemetry_init(void)
+{
+#ifdef ENABLE_TELEMETRY_LIFETIME
+    eeprom_read_block(stored, eeprom_storage.telemetry, sizeof(stored));
+
+    /* erased eeprom */
+    for (uint8_t i = 0; i < TELEMETRY_COUNTERS; i++) {
+        if (stored[i] == 0xffffffff)
+            stored[i] = 0;
+    }
+#endif
+}
+
+uint8_t telemetry_read(uint8_t offset, bool lifetime)
+{
+    if (offset == 0)
+        return TELEMETRY_VERSION;
+    if (offset == 1)
+        return telemetry_sck;
+
+    offset -= 2;
+#ifdef ENABLE_TELEMETRY_LIFETIME
+    if (lifetime)
+        return (stored[offset/4] + telemetry[offset/4]) >> 8*(offset % 4);
+#else
+    (void)lifetime;
+#endif
+
+    return telemetry[offset/4] >> 8*(offset % 4);
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* counters since power-up, optionally also summed up over the lifetime of
+ * the programmer in eeprom (ENABLE_TELEMETRY_LIFETIME), to find programmers
+ * which need more and more retries over time */
+#define TELEMETRY_ATTACHES          0   /* successful isp_attach() calls */
+#define TELEMETRY_ATTACH_FAILED_HW  1   /* hardware spi did not attach */
+#define TELEMETRY_ATTACH_FAILED_SW  2   /* software (and gang) spi did not attach */
+#define TELEMETRY_MAGIC_RETRIES     3   /* programming enable without echo */
+#define TELEMETRY_FLASH_READ        4   /* bytes */
+#define TELEMETRY_FLASH_WRITTEN     5
+#define TELEMETRY_EEPROM_READ       6
+#define TELEMETRY_EEPROM_WRITTEN    7
+#define TELEMETRY_PAGES             8   /* flash pages saved */
+#define TELEMETRY_POLLS             9   /* reads while waiting for a write */
+#define TELEMETRY_POLL_TIMEOUTS     10  /* writes which were never done */
+#define TELEMETRY_COUNTERS          11
+
+/* record returned by FUNC_TELEMETRY: version, sck and the counters as
+ * 32 bit little endian values in the order above */
+#define TELEMETRY_VERSION       1
+#define TELEMETRY_RECORD        (2 + 4*TELEMETRY_COUNTERS)
+
+/* sck of the last attach: hardware spi with the prescaler in bits 0-1, or
+ * the USBASP_ISP_SCK_* value for software spi (0 is the default delay) */
+#define TELEMETRY_HARDWARE      0x80
+
+#ifdef ENABLE_TELEMETRY
+extern uint32_t telemetry[TELEMETRY_COUNTERS];
+extern uint8_t telemetry_sck;
+
+void telemetry_init(void);
+/* byte of the record, power cycle or lifetime counters */
+uint8_t telemetry_read(uint8_t offset, bool lifetime);
+
+#ifdef ENABLE_TELEMETRY_LIFETIME
+/* write the lifetime counters to eeprom, in the background */
+void telemetry_save(void);
+void telemetry_poll(void);
+#endif
+
+#define TELEMETRY_ADD(counter, n)   (telemetry[counter] += (n))
+#else
+#define TELEMETRY_ADD(counter, n)
+#endif
+
+#endif
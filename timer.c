@@ -27,52 +27,122 @@
 #include "timer.h"
 #include "platform.h"
 
-static volatile uint8_t internal_counter;
+#define OVERFLOW_CYCLES     (256UL * TIMER_STEP_CYCLES)
+#define MS_CYCLES           (F_CPU/1000)
+
+/* overflows of timer2, the clock is overflows << 8 | TCNT2 */
+static volatile uint32_t overflows;
+
+/* the millisecond clock at the last overflow, the remainder is in cycles */
+static volatile uint32_t ms;
+static volatile uint16_t ms_cycles;
 
 void timer_init(void)
 {
-    /* initialize timer2, CTC at 10ms, prescaler 1024 */
-    OCR2A = F_CPU/1024/100;
-    TCCR2A = _BV(WGM21);
-    TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);
-    TIMSK2 = _BV(OCIE2A);
+    /* initialize timer2, normal mode, prescaler 1024 */
+    TCCR2A = 0;
+    /* on the atmega8 TCCR2A and TCCR2B are the same register */
+    TCCR2B |= _BV(CS22) | _BV(CS21) | _BV(CS20);
+    /* the atmega8 has one TIMSK for all timers */
+    TIMSK2 |= _BV(TOIE2);
 }
 
-void timer_set(timer_t *t, uint8_t timeout)
+/* overflows and the low byte of the clock, including an overflow whose
+ * interrupt is still pending, called with interrupts disabled */
+static uint8_t timer_read(uint32_t *high)
 {
-    t->current = internal_counter;
-    t->timeout = timeout;
+    uint8_t low = TCNT2;
+    *high = overflows;
+
+    if ((TIFR2 & _BV(TOV2)) && low < 0x80)
+        (*high)++;
+
+    return low;
 }
 
-bool timer_expired(timer_t *t)
+uint32_t timer_now(void)
 {
-    if (t->timeout == 0)
-        return true;
-
-    /* attention: this is not correct, if internal_counter is incremented by more than one
-     * between two calls of timer_expired()! */
-    if (t->current != internal_counter) {
-        t->timeout--;
-        t->current = internal_counter;
+    uint8_t sreg = SREG;
+    cli();
+
+    uint32_t high;
+    uint8_t low = timer_read(&high);
+
+    SREG = sreg;
+
+    return high << 8 | low;
+}
+
+uint32_t timer_ms(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    uint32_t high;
+    uint8_t low = timer_read(&high);
+    uint32_t result = ms;
+    uint32_t cycles = ms_cycles;
+
+    /* overflow whose interrupt is still pending */
+    if (high != overflows)
+        cycles += OVERFLOW_CYCLES;
+
+    SREG = sreg;
+
+    /* at most two overflows worth of cycles, cheaper than a division */
+    cycles += (uint32_t)low * TIMER_STEP_CYCLES;
+    while (cycles >= MS_CYCLES) {
+        cycles -= MS_CYCLES;
+        result++;
     }
 
-    return false;
+    return result;
 }
 
-/* timer interrupt function */
-#if defined(__AVR_ATmega8__)
-    #define TIMER2_VECT TIMER2_COMP_vect
-#elif defined(__AVR_ATmega48__) || defined(__AVR_ATmega88__) || defined(__AVR_ATmega168__)
-    #define TIMER2_VECT TIMER2_COMPA_vect
-#else
-    #error "unsupported platform!"
-#endif
+bool timer_reached(uint32_t time)
+{
+    return (int32_t)(timer_now() - time) >= 0;
+}
+
+void timer_set(timer_t *t, uint16_t timeout)
+{
+    t->deadline = timer_now() + TIMER_MS(timeout);
+    t->running = true;
+}
+
+bool timer_expired(timer_t *t)
+{
+    /* remember the expiry, a deadline far in the past would look like one in
+     * the future after the wraparound */
+    if (t->running && timer_reached(t->deadline))
+        t->running = false;
+
+    return !t->running;
+}
 
+uint16_t timer_timestamp(void)
+{
+    return timer_now();
+}
+
+uint16_t timer_since(uint16_t timestamp)
+{
+    return timer_timestamp() - timestamp;
+}
+
+/* timer interrupt function */
 #if __AVR_LIBC_VERSION__ < 10600UL
-ISR(TIMER2_VECT)
+ISR(TIMER2_OVF_vect)
 #else
-ISR(TIMER2_VECT, ISR_NOBLOCK)
+ISR(TIMER2_OVF_vect, ISR_NOBLOCK)
 #endif
 {
-    internal_counter++;
+    overflows++;
+
+    ms += OVERFLOW_CYCLES / MS_CYCLES;
+    ms_cycles += OVERFLOW_CYCLES % MS_CYCLES;
+    if (ms_cycles >= MS_CYCLES) {
+        ms_cycles -= MS_CYCLES;
+        ms++;
+    }
 }
@@ -20,7 +20,13 @@
  * http://www.gnu.org/copyleft/gpl.html
  */
 
-/* small timer library, uses timer2 */
+/* small timer library, uses timer2
+ *
+ * timer2 counts steps of 1024 cycles (64us at 16MHz), its overflow interrupt
+ * (every 256 steps, 16.4ms at 16MHz) extends it to a monotonic 32 bit clock,
+ * which wraps after 2^32 steps (76 hours at 16MHz).  an overflow which has
+ * not been handled yet is taken into account, so the clock is correct unless
+ * interrupts are disabled for longer than 256 steps */
 
 #ifndef __TIMER_H
 #define __TIMER_H
@@ -28,15 +34,30 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#define TIMER_STEP_CYCLES   1024
+/* steps of at least ms milliseconds, for constants */
+#define TIMER_MS(ms)        (((uint32_t)(ms) * (F_CPU/1000) + TIMER_STEP_CYCLES-1) / TIMER_STEP_CYCLES)
+
 /* structures */
 typedef struct {
-    uint8_t current;
-    uint8_t timeout;
+    uint32_t deadline;
+    bool running;
 } timer_t;
 
 /* functions */
 void timer_init(void);
-void timer_set(timer_t *t, uint8_t timeout);
+/* monotonic clock in steps and in milliseconds */
+uint32_t timer_now(void);
+uint32_t timer_ms(void);
+/* true if the clock has reached time, which must be less than 2^31 steps
+ * away, so that it is correct across the wraparound */
+bool timer_reached(uint32_t time);
+/* one-shot timer, expired after timeout milliseconds */
+void timer_set(timer_t *t, uint16_t timeout);
 bool timer_expired(timer_t *t);
+/* 16 bit timestamps in steps, wrap after 4.2s at 16MHz */
+uint16_t timer_timestamp(void);
+/* steps since a timestamp, less than 65536 steps ago */
+uint16_t timer_since(uint16_t timestamp);
 
 #endif
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+#
+# kahuna -- simple USBasp compatible isp programmer
+#
+# runs the sampling profiler (ENABLE_SAMPLER, see sampler.h) via usb (pyusb)
+# and maps the histogram to the symbols of the firmware, e.g. start it,
+# program a device with avrdude in another terminal, then press enter:
+#
+# usage: sampler.py [-r RATE] [--base ADDR] [--shift N] [-t SECONDS] kahuna.elf
+#        sampler.py --read kahuna.elf
+
+import argparse
+import struct
+import subprocess
+import sys
+import time
+
+USB_VID = 0x16c0
+USB_PID = 0x05dc
+FUNC_SAMPLER_START = 0x40
+FUNC_SAMPLER_READ = 0x41
+
+# keep in sync with struct sampler_t in sampler.h
+SAMPLER_BINS = 64
+HEADER = '<HBBH'
+
+
+def symbols(elf, nm):
+    # sorted (byte address, name) of the code symbols
+    out = subprocess.check_output([nm, '-n', '--defined-only', elf],
+                                  universal_newlines=True)
+    syms = []
+    end = 0
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) != 3:
+            continue
+        addr, kind, name = int(fields[0], 16), fields[1], fields[2]
+        if name == '_etext':
+            end = addr
+        if kind in 'tTwW' and addr < 0x800000:
+            syms.append((addr, name))
+    if not end and syms:
+        end = syms[-1][0]
+    return syms, end
+
+
+def names(syms, start, end):
+    # symbols covering the byte range [start, end)
+    found = []
+    for i, (addr, name) in enumerate(syms):
+        next_addr = syms[i + 1][0] if i + 1 < len(syms) else None
+        if addr < end and (next_addr is None or next_addr > start):
+            if name not in found:
+                found.append(name)
+    return found
+
+
+def auto_shift(base, end):
+    # smallest bins which cover the code from base on
+    shift = 0
+    while ((end // 2 - base) >> shift) >= SAMPLER_BINS:
+        shift += 1
+    return shift
+
+
+def report(raw, syms):
+    base, shift, rate, outside = struct.unpack_from(HEADER, raw)
+    bins = struct.unpack_from('<%dH' % SAMPLER_BINS, raw, struct.calcsize(HEADER))
+    total = sum(bins) + outside
+    if total == 0:
+        print('no samples (rate %d)' % rate)
+        return
+
+    # bins covering the same symbols are added up
+    groups = {}
+    for i, count in enumerate(bins):
+        if not count:
+            continue
+        start = (base + (i << shift)) * 2
+        end = start + (2 << shift)
+        key = ' / '.join(names(syms, start, end)) or '?'
+        groups[key] = groups.get(key, 0) + count
+    if outside:
+        groups['(outside of the bins)'] = outside
+
+    print('%d samples, rate %d, base 0x%04x, %d bytes per bin' %
+          (total, rate, base * 2, 2 << shift))
+    for key, count in sorted(groups.items(), key=lambda g: -g[1]):
+        print('%8d %6.2f%%  %s' % (count, 100.0 * count / total, key))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='run the kahuna sampling profiler')
+    parser.add_argument('-r', '--rate', type=int, default=2,
+                        help='timer0 clock select 1-5, one sample per 256 clocks (default 2, F_CPU/8)')
+    parser.add_argument('--base', type=lambda s: int(s, 0), default=0,
+                        help='byte address of the first bin (default 0)')
+    parser.add_argument('--shift', type=int,
+                        help='each bin covers 2 << SHIFT bytes (default: the whole code in 64 bins)')
+    parser.add_argument('-t', '--time', type=float,
+                        help='sample for TIME seconds instead of until enter is pressed')
+    parser.add_argument('--read', action='store_true',
+                        help='only read the histogram of a previous run')
+    parser.add_argument('--nm', default='avr-nm',
+                        help='nm of the avr toolchain (default avr-nm)')
+    parser.add_argument('elf', help='firmware of the programmer (kahuna.elf)')
+    args = parser.parse_args()
+
+    syms, end = symbols(args.elf, args.nm)
+
+    import usb.core
+
+    dev = usb.core.find(idVendor=USB_VID, idProduct=USB_PID)
+    if dev is None:
+        sys.exit('programmer not found')
+
+    if not args.read:
+        base = args.base // 2
+        shift = args.shift if args.shift is not None else auto_shift(base, end)
+        dev.ctrl_transfer(0xc0, FUNC_SAMPLER_START, args.rate | shift << 8, base, 4)
+        if args.time is not None:
+            time.sleep(args.time)
+        else:
+            input('sampling, press enter to stop')
+        # stopping keeps the histogram
+        dev.ctrl_transfer(0xc0, FUNC_SAMPLER_START, 0, 0, 4)
+
+    raw = bytes(dev.ctrl_transfer(0xc0, FUNC_SAMPLER_READ, 0, 0, 254))
+
+    report(raw, syms)
+
+
+if __name__ == '__main__':
+    main()
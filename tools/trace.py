@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+#
+# kahuna -- simple USBasp compatible isp programmer
+#
+# decodes the debug trace (see debug.h) and prints a timeline, read from a
+# uart capture or tty (DEBUG_UART, configure the tty first, e.g. with
+# "stty -F /dev/ttyUSB0 raw 115200") or from the programmer via usb (pyusb)
+#
+# usage: trace.py [-f F_CPU] file
+#        trace.py [-f F_CPU] --usb [--follow]
+
+import argparse
+import struct
+import sys
+import time
+
+# event ids, keep in sync with debug.h
+EVENTS = {
+    0x01: ('boot', None),
+    0x02: ('lost', 'events'),
+    0x03: ('connect', None),
+    0x04: ('disconnect', None),
+    0x05: ('read', 'request'),
+    0x06: ('write', 'request'),
+    0x07: ('enable programming', None),
+    0x10: ('attach auto', None),
+    0x11: ('attach hardware spi', None),
+    0x12: ('attach software spi', None),
+    0x13: ('attach manual', 'sck option'),
+    0x14: ('attach gang', None),
+    0x15: ('attach slot', None),
+    0x16: ('attached', None),
+    0x17: ('try prescaler', 'prescaler'),
+    0x18: ('prescaler failed', None),
+    0x19: ('prescaler found', 'prescaler'),
+    0x20: ('stub start', 'prescaler'),
+    0x21: ('stub finish', 'sck option'),
+    0x28: ('tpi connect', None),
+    0x29: ('tpi disconnect', None),
+    0x2a: ('tpi timeout', None),
+    0x2b: ('tpi frame error', None),
+    0x30: ('standalone start', None),
+    0x31: ('standalone result', 'result'),
+}
+
+EVENT_SIZE = 4
+SYNC = 0xff
+
+USB_VID = 0x16c0
+USB_PID = 0x05dc
+FUNC_TRACE_READ = 0x3e
+
+
+class Timeline:
+    def __init__(self, f_cpu):
+        # timer steps of 1024 cycles, 16 bit timestamps
+        self.step = 1024.0 / f_cpu
+        self.wrap = 65536
+        self.last = None
+        self.steps = 0
+
+    def event(self, event, data, stamp):
+        if self.last is None:
+            delta = 0
+        else:
+            delta = (stamp - self.last) % self.wrap
+            # the boot event restarts the clock
+            if event == 0x01:
+                self.steps = 0
+                delta = 0
+        self.last = stamp
+        self.steps += delta
+
+        name, unit = EVENTS.get(event, ('unknown 0x%02x' % event, 'data'))
+        line = '%10.3f ms %+9.3f  %s' % (self.steps * self.step * 1000,
+                                          delta * self.step * 1000, name)
+        if unit:
+            line += ' (%s %d)' % (unit, data)
+        print(line)
+        sys.stdout.flush()
+
+    def events(self, raw):
+        for i in range(0, len(raw) - EVENT_SIZE + 1, EVENT_SIZE):
+            self.event(*struct.unpack_from('<BBH', raw, i))
+
+
+def read_uart(name, timeline):
+    # each event is sent as 0xff and the 4 bytes of the event, the event id
+    # is never 0xff, so a frame starts at a 0xff followed by a known id
+    buf = bytearray()
+    with open(name, 'rb', buffering=0) as f:
+        while True:
+            data = f.read(256)
+            if not data:
+                break
+            buf += data
+            while len(buf) >= 1 + EVENT_SIZE:
+                if buf[0] != SYNC or buf[1] not in EVENTS:
+                    del buf[0]
+                    continue
+                timeline.events(bytes(buf[1:1 + EVENT_SIZE]))
+                del buf[:1 + EVENT_SIZE]
+
+
+def read_usb(timeline, follow):
+    import usb.core
+
+    dev = usb.core.find(idVendor=USB_VID, idProduct=USB_PID)
+    if dev is None:
+        sys.exit('programmer not found')
+
+    while True:
+        raw = bytes(dev.ctrl_transfer(0xc0, FUNC_TRACE_READ, 0, 0, 252))
+        timeline.events(raw)
+        if not follow:
+            if len(raw) < 252:
+                break
+        elif not raw:
+            time.sleep(0.1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode the kahuna debug trace')
+    parser.add_argument('-f', '--f-cpu', type=int, default=16000000,
+                        help='clock of the programmer (default 16000000)')
+    parser.add_argument('--usb', action='store_true',
+                        help='read the buffered events via usb')
+    parser.add_argument('--follow', action='store_true',
+                        help='keep reading via usb')
+    parser.add_argument('file', nargs='?',
+                        help='uart capture or tty')
+    args = parser.parse_args()
+
+    timeline = Timeline(args.f_cpu)
+    try:
+        if args.usb:
+            read_usb(timeline, args.follow)
+        elif args.file:
+            read_uart(args.file, timeline)
+        else:
+            parser.error('a file or --usb is required')
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,209 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <util/delay.h>
+#include "config.h"
+#include "spi.h"
+#include "tpi.h"
+#include "debug.h"
+
+#ifdef ENABLE_TPI
+
+static struct {
+    uint16_t delay;
+    uint16_t address;   /* current pointer register, for consecutive blocks */
+    bool pointer_valid;
+} tpi;
+
+static void tpi_delay(void)
+{
+    if (tpi.delay)
+        _delay_loop_2(tpi.delay);
+}
+
+/* the device samples TPIDATA on the rising edge of TPICLK and changes it
+ * after the falling edge */
+static void tpi_send_bit(uint8_t bit)
+{
+    if (bit)
+        SPI_PORT |= _BV(SPI_MOSI);
+    else
+        SPI_PORT &= ~_BV(SPI_MOSI);
+
+    tpi_delay();
+    SPI_PORT |= _BV(SPI_SCK);
+    tpi_delay();
+    SPI_PORT &= ~_BV(SPI_SCK);
+}
+
+static uint8_t tpi_recv_bit(void)
+{
+    tpi_delay();
+    uint8_t bit = (SPI_PIN & _BV(SPI_MISO)) ? 1 : 0;
+    SPI_PORT |= _BV(SPI_SCK);
+    tpi_delay();
+    SPI_PORT &= ~_BV(SPI_SCK);
+
+    return bit;
+}
+
+static void tpi_send_byte(uint8_t data)
+{
+    uint8_t parity = 0;
+
+    /* start bit, data (lsb first), even parity and two stop bits */
+    tpi_send_bit(0);
+    for (uint8_t i = 0; i < 8; i++) {
+        parity ^= data & 1;
+        tpi_send_bit(data & 1);
+        data >>= 1;
+    }
+    tpi_send_bit(parity);
+    tpi_send_bit(1);
+    tpi_send_bit(1);
+}
+
+uint8_t tpi_recv(void)
+{
+    /* release the line (MOSI is connected through a resistor) and wait for
+     * the start bit after the guard time */
+    SPI_PORT |= _BV(SPI_MOSI);
+
+    uint8_t i = TPI_START_TRIES;
+    while (tpi_recv_bit()) {
+        if (--i == 0) {
+            debug_event(DEBUG_TPI_TIMEOUT, 0);
+            return 0xff;
+        }
+    }
+
+    uint8_t data = 0;
+    uint8_t parity = 0;
+    for (i = 0; i < 8; i++) {
+        uint8_t bit = tpi_recv_bit();
+        parity ^= bit;
+        data = (data >> 1) | (bit << 7);
+    }
+
+    parity ^= tpi_recv_bit();
+    uint8_t stop = tpi_recv_bit() & tpi_recv_bit();
+
+    if (parity || !stop) {
+        debug_event(DEBUG_TPI_FRAME_ERROR, 0);
+        return 0xff;
+    }
+
+    return data;
+}
+
+void tpi_send(uint8_t data)
+{
+    /* raw instructions may change the pointer register */
+    tpi.pointer_valid = false;
+    tpi_send_byte(data);
+}
+
+static void tpi_pointer(uint16_t address)
+{
+    if (tpi.pointer_valid && tpi.address == address)
+        return;
+
+    tpi_send_byte(TPI_SSTPR(0));
+    tpi_send_byte(LO8(address));
+    tpi_send_byte(TPI_SSTPR(1));
+    tpi_send_byte(HI8(address));
+
+    tpi.address = address;
+    tpi.pointer_valid = true;
+}
+
+void tpi_read_block(uint16_t address, uint8_t *data, uint8_t len)
+{
+    tpi_pointer(address);
+
+    while (len--) {
+        tpi_send_byte(TPI_SLD_INC);
+        *data++ = tpi_recv();
+        tpi.address++;
+    }
+}
+
+void tpi_write_block(uint16_t address, uint8_t *data, uint8_t len)
+{
+    tpi_pointer(address);
+
+    while (len--) {
+        tpi_send_byte(TPI_SST_INC);
+        tpi_send_byte(*data++);
+        tpi.address++;
+
+        /* a word write is started by the high byte, wait for the nvm
+         * controller (this returns immediately for other memories) */
+        if ((tpi.address & 1) == 0) {
+            for (uint8_t i = 0; i < TPI_BUSY_TRIES; i++) {
+                tpi_send_byte(TPI_SIN(TPI_NVMCSR));
+                if (!(tpi_recv() & TPI_NVMBSY))
+                    break;
+            }
+        }
+    }
+}
+
+void tpi_connect(uint16_t delay)
+{
+    debug_event(DEBUG_TPI_CONNECT, 0);
+
+    tpi.delay = delay;
+    tpi.pointer_valid = false;
+
+    /* pulse reset and keep the device in reset, TPICLK and TPIDATA are
+     * outputs and MISO an input */
+    spi_disable();
+    spi_enable();
+    SPI_PORT |= _BV(SPI_MOSI);
+
+    /* the interface is enabled after at least 16 clock cycles with TPIDATA high */
+    for (uint8_t i = 0; i < 32; i++)
+        tpi_send_bit(1);
+}
+
+void tpi_disconnect(void)
+{
+    debug_event(DEBUG_TPI_DISCONNECT, 0);
+
+    /* clear NVMEN and release the device from reset */
+    tpi_send_byte(TPI_SSTCS(TPI_TPISR));
+    tpi_send_byte(0);
+    for (uint8_t i = 0; i < 10; i++)
+        tpi_send_bit(1);
+
+    spi_release();
+    spi_disable();
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __TPI_H
+#define __TPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* tpi (tiny programming interface) for ATtiny4/5/9/10/20/40 on the isp
+ * header: TPICLK on SCK, TPIDATA on MOSI, which must be connected to MISO
+ * through a resistor (like USBasp) */
+
+/* instructions */
+#define TPI_SLD         0x20
+#define TPI_SLD_INC     0x24
+#define TPI_SST         0x60
+#define TPI_SST_INC     0x64
+#define TPI_SSTPR(a)    (0x68 | (a))
+#define TPI_SIN(a)      (0x10 | (((a) & 0x30) << 1) | ((a) & 0x0f))
+#define TPI_SOUT(a)     (0x90 | (((a) & 0x30) << 1) | ((a) & 0x0f))
+#define TPI_SLDCS(a)    (0x80 | (a))
+#define TPI_SSTCS(a)    (0xc0 | (a))
+#define TPI_SKEY        0xe0
+
+/* registers */
+#define TPI_TPISR       0x00
+#define TPI_NVMCSR      0x32
+#define TPI_NVMBSY      _BV(7)
+
+/* enter tpi mode, delay is the half bit time (for _delay_loop_2) */
+void tpi_connect(uint16_t delay);
+void tpi_disconnect(void);
+
+void tpi_send(uint8_t data);
+/* returns 0xff on framing or parity errors and timeouts */
+uint8_t tpi_recv(void);
+
+/* stream data from or to the data space starting at address, the address
+ * is sent only once, writes wait for the nvm controller after each word */
+void tpi_read_block(uint16_t address, uint8_t *data, uint8_t len);
+void tpi_write_block(uint16_t address, uint8_t *data, uint8_t len);
+
+#endif
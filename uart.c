@@ -0,0 +1,166 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "config.h"
+#include "platform.h"
+#include "uart.h"
+
+#ifdef ENABLE_UART_BRIDGE
+
+#if (UART_RX_BUFFER & (UART_RX_BUFFER-1)) || (UART_TX_BUFFER & (UART_TX_BUFFER-1))
+#error "uart buffer sizes must be powers of two"
+#endif
+
+static struct {
+    uint8_t buf[UART_RX_BUFFER];
+    volatile uint8_t head;
+    uint8_t tail;
+} rx;
+
+static struct {
+    uint8_t buf[UART_TX_BUFFER];
+    uint8_t head;
+    volatile uint8_t tail;
+} tx;
+
+static volatile uint8_t errors;
+
+uint32_t uart_config(uint32_t baud)
+{
+    UCSR0B = 0;
+
+    rx.head = rx.tail = 0;
+    tx.head = tx.tail = 0;
+    errors = 0;
+
+    if (baud == 0 || baud > F_CPU/8)
+        return 0;
+
+    /* double speed, 8N1 */
+    uint16_t ubrr = (F_CPU/8 + baud/2) / baud - 1;
+    UBRR0H = HI8(ubrr);
+    UBRR0L = LO8(ubrr);
+    UCSR0A = _BV(U2X0);
+    UCSR0C = UCSR0C_SELECT | _BV(UCSZ00) | _BV(UCSZ01);
+    UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+
+    return F_CPU/8 / (ubrr + 1);
+}
+
+uint8_t uart_rx_available(void)
+{
+    return (rx.head - rx.tail) & (UART_RX_BUFFER-1);
+}
+
+uint8_t uart_tx_free(void)
+{
+    return (tx.tail - tx.head - 1) & (UART_TX_BUFFER-1);
+}
+
+uint8_t uart_errors(void)
+{
+    uint8_t e;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        e = errors;
+        errors = 0;
+    }
+
+    return e;
+}
+
+uint8_t uart_getc(void)
+{
+    uint8_t data = rx.buf[rx.tail];
+    rx.tail = (rx.tail + 1) & (UART_RX_BUFFER-1);
+
+    return data;
+}
+
+void uart_putc(uint8_t data)
+{
+    /* errors and UCSR0B are also changed by the interrupt handlers */
+    if (uart_tx_free() == 0) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            errors |= UART_TX_OVERFLOW;
+        return;
+    }
+
+    tx.buf[tx.head] = data;
+    tx.head = (tx.head + 1) & (UART_TX_BUFFER-1);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        UCSR0B |= _BV(UDRIE0);
+}
+
+/* the handlers are called with their interrupt masked and interrupts enabled
+ * (see UART_ISR() in platform.h) */
+void __vector_uart_rx(void) ISR_HANDLER;
+void __vector_uart_rx(void)
+{
+    /* the flags belong to the byte in UDR0, read them first */
+    uint8_t status = UCSR0A;
+    if (status & _BV(FE0))
+        errors |= UART_FRAME_ERROR;
+    if (status & _BV(DOR0))
+        errors |= UART_DATA_OVERRUN;
+
+    uint8_t data = UDR0;
+    uint8_t head = (rx.head + 1) & (UART_RX_BUFFER-1);
+
+    if (head == rx.tail)
+        errors |= UART_RX_OVERFLOW;
+    else {
+        rx.buf[rx.head] = data;
+        rx.head = head;
+    }
+
+    cli();
+    UCSR0B |= _BV(RXCIE0);
+}
+
+/* called with the data register empty interrupt masked and interrupts enabled */
+void __vector_uart_udre(void) ISR_HANDLER;
+void __vector_uart_udre(void)
+{
+    if (tx.tail == tx.head)
+        return;
+
+    UDR0 = tx.buf[tx.tail];
+    tx.tail = (tx.tail + 1) & (UART_TX_BUFFER-1);
+
+    cli();
+    UCSR0B |= _BV(UDRIE0);
+}
+
+UART_ISR(UART_RX_VECT, __vector_uart_rx, RXCIE0)
+UART_ISR(UART_UDRE_VECT, __vector_uart_udre, UDRIE0)
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __UART_H
+#define __UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* usb to uart bridge to the target, interrupt driven with ring buffers of
+ * UART_RX_BUFFER and UART_TX_BUFFER bytes */
+
+/* error flags */
+#define UART_RX_OVERFLOW    _BV(0)  /* receive buffer full, data lost */
+#define UART_TX_OVERFLOW    _BV(1)  /* transmit buffer full, data lost */
+#define UART_FRAME_ERROR    _BV(2)
+#define UART_DATA_OVERRUN   _BV(3)  /* the usart lost a byte, its handler was late */
+
+/* enable the bridge (8N1) in double speed mode, 0 disables it, returns the
+ * baudrate actually used (0 if disabled or too fast for F_CPU).  UBRR
+ * rounds F_CPU/8/baud: at 16MHz 115200 becomes 117647 (+2.1%, the limit
+ * for 8N1), 250000, 500000 and 1000000 are exact */
+uint32_t uart_config(uint32_t baud);
+
+uint8_t uart_rx_available(void);
+uint8_t uart_tx_free(void);
+/* returns and clears the error flags */
+uint8_t uart_errors(void);
+
+uint8_t uart_getc(void);
+void uart_putc(uint8_t data);
+
+#endif
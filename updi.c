@@ -0,0 +1,195 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <util/delay.h>
+#include "config.h"
+#include "platform.h"
+#include "updi.h"
+
+#ifdef ENABLE_UPDI
+
+static bool rsd;
+
+bool updi_recv(uint8_t *data)
+{
+    uint16_t timeout = UPDI_TIMEOUT;
+
+    while (!(UCSR0A & _BV(RXC0))) {
+        if (--timeout == 0)
+            return false;
+    }
+
+    /* error flags must be read before UDR */
+    uint8_t status = UCSR0A;
+    *data = UDR0;
+
+    return !(status & (_BV(FE0) | _BV(UPE0)));
+}
+
+bool updi_send(uint8_t data)
+{
+    uint8_t echo;
+
+    UDR0 = data;
+
+    /* receiver and transmitter share the line */
+    return updi_recv(&echo) && echo == data;
+}
+
+static bool updi_instruction(uint8_t opcode)
+{
+    return updi_send(UPDI_SYNCH) && updi_send(opcode);
+}
+
+static bool updi_ack(void)
+{
+    uint8_t ack;
+
+    return updi_recv(&ack) && ack == UPDI_ACK;
+}
+
+static bool updi_stcs(uint8_t reg, uint8_t value)
+{
+    return updi_instruction(UPDI_STCS(reg)) && updi_send(value);
+}
+
+static uint8_t updi_ldcs(uint8_t reg)
+{
+    uint8_t value;
+
+    if (updi_instruction(UPDI_LDCS(reg)) && updi_recv(&value))
+        return value;
+    return 0;
+}
+
+static bool updi_repeat(uint8_t len)
+{
+    return updi_instruction(UPDI_REPEAT) && updi_send(len - 1);
+}
+
+bool updi_pointer(uint16_t address)
+{
+    return updi_instruction(UPDI_ST_PTR) && updi_send(LO8(address))
+        && updi_send(HI8(address)) && updi_ack();
+}
+
+bool updi_read_block(uint8_t *data, uint8_t len)
+{
+    if (len > 1 && !updi_repeat(len))
+        return false;
+
+    if (!updi_instruction(UPDI_LD_PTR_INC))
+        return false;
+
+    while (len--) {
+        if (!updi_recv(data++))
+            return false;
+    }
+
+    return true;
+}
+
+bool updi_write_block(uint8_t *data, uint8_t len)
+{
+    if (!rsd) {
+        if (!updi_stcs(UPDI_CTRLA, UPDI_CTRLA_IBDLY | UPDI_CTRLA_RSD))
+            return false;
+        rsd = true;
+    }
+
+    if (len > 1 && !updi_repeat(len))
+        return false;
+
+    if (!updi_instruction(UPDI_ST_PTR_INC))
+        return false;
+
+    while (len--) {
+        if (!updi_send(*data++))
+            return false;
+    }
+
+    return true;
+}
+
+bool updi_write_end(void)
+{
+    rsd = false;
+    return updi_stcs(UPDI_CTRLA, UPDI_CTRLA_IBDLY);
+}
+
+static void updi_break(void)
+{
+    /* hold the line low as gpio for longer than a break at the slowest
+     * possible baudrate (double break, ~25ms) */
+    UCSR0B = 0;
+    DDRD |= _BV(PD1);
+    PORTD &= ~_BV(PD1);
+    for (uint8_t i = 0; i < 3; i++)
+        _delay_loop_2(F_CPU/100/4);     /* 10ms */
+    PORTD |= _BV(PD1);
+    _delay_loop_2(F_CPU/10000/4);       /* 100us */
+}
+
+uint8_t updi_connect(void)
+{
+    /* 8 data bits, even parity, 2 stop bits */
+    #define BAUD UPDI_BAUD
+    #include <util/setbaud.h>
+
+    updi_break();
+
+    UBRR0H = UBRRH_VALUE;
+    UBRR0L = UBRRL_VALUE;
+#if USE_2X
+    UCSR0A |= _BV(U2X0);
+#else
+    UCSR0A &= ~_BV(U2X0);
+#endif
+    UCSR0C = UCSR0C_SELECT | _BV(UPM01) | _BV(USBS0) | _BV(UCSZ00) | _BV(UCSZ01);
+    UCSR0B = _BV(TXEN0) | _BV(RXEN0);
+
+    /* disable collision detection, inter-byte delay for responses */
+    rsd = false;
+    if (!updi_stcs(UPDI_CTRLB, UPDI_CTRLB_CCDETDIS)
+            || !updi_stcs(UPDI_CTRLA, UPDI_CTRLA_IBDLY))
+        return 0;
+
+    return updi_ldcs(UPDI_STATUSA);
+}
+
+void updi_disconnect(void)
+{
+    updi_stcs(UPDI_CTRLB, UPDI_CTRLB_UPDIDIS);
+
+    /* release the line */
+    UCSR0B = 0;
+    DDRD &= ~_BV(PD1);
+    PORTD &= ~_BV(PD1);
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * kahuna -- simple USBasp compatible isp programmer
+ *
+ *   by Alexander Neumann <alexander@lochraster.org>
+ *
+ * inspired by USBasp by Thomas Fischl,
+ * see http://www.obdev.at/products/avrusb/usbasploader.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __UPDI_H
+#define __UPDI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* updi for tinyAVR-0/1/2 and AVR-Dx devices via the uart in half duplex
+ * mode: RXD connected to the UPDI pin, TXD through a resistor */
+
+/* instructions */
+#define UPDI_SYNCH          0x55
+#define UPDI_ACK            0x40
+#define UPDI_LDS            0x04    /* 16 bit address, byte */
+#define UPDI_STS            0x44
+#define UPDI_LD_PTR_INC     0x24    /* byte */
+#define UPDI_ST_PTR_INC     0x64
+#define UPDI_ST_PTR         0x69    /* set pointer, 16 bit */
+#define UPDI_LDCS(r)        (0x80 | (r))
+#define UPDI_STCS(r)        (0xc0 | (r))
+#define UPDI_REPEAT         0xa0    /* byte count */
+
+/* control and status registers */
+#define UPDI_STATUSA        0x00
+#define UPDI_CTRLA          0x02
+#define UPDI_CTRLB          0x03
+
+#define UPDI_CTRLA_IBDLY    _BV(7)
+#define UPDI_CTRLA_RSD      _BV(3)
+#define UPDI_CTRLB_UPDIDIS  _BV(2)
+#define UPDI_CTRLB_CCDETDIS _BV(3)
+
+/* send a break, enable the interface and return STATUSA (0 on failure) */
+uint8_t updi_connect(void);
+void updi_disconnect(void);
+
+/* raw access, the echo of sent data is discarded, returns false on errors */
+bool updi_send(uint8_t data);
+/* returns false on timeouts and framing or parity errors */
+bool updi_recv(uint8_t *data);
+
+/* blocks of the data space: set the pointer once, then each block is one
+ * REPEAT and ST/LD with pointer increment, so no addresses are resent */
+bool updi_pointer(uint16_t address);
+bool updi_read_block(uint8_t *data, uint8_t len);
+/* no ack for the data bytes (response signature disabled while streaming) */
+bool updi_write_block(uint8_t *data, uint8_t len);
+bool updi_write_end(void);
+
+#endif
@@ -29,12 +29,27 @@
 #include <avr/io.h>
 #include <avr/eeprom.h>
 #include <util/crc16.h>
+#include <util/delay.h>
 #include "config.h"
 #include "usb.h"
 #include "usbdrv/usbdrv.h"
 #include "spi.h"
+#include "stub.h"
+#include "tpi.h"
+#include "updi.h"
+#include "spiflash.h"
+#include "i2c.h"
+#include "uart.h"
+#include "clock.h"
+#include "storage.h"
+#include "standalone.h"
 #include "debug.h"
 #include "random.h"
+#include "profile.h"
+#include "pollstats.h"
+#include "telemetry.h"
+#include "sampler.h"
+#include "memory.h"
 
 /* USBasp requests, taken from the original USBasp sourcecode */
 #define USBASP_FUNC_CONNECT     1
@@ -47,6 +62,15 @@
 #define USBASP_FUNC_WRITEEEPROM 8
 #define USBASP_FUNC_SETLONGADDRESS 9
 #define USBASP_FUNC_SETISPSCK   10
+#define USBASP_FUNC_TPI_CONNECT     11
+#define USBASP_FUNC_TPI_DISCONNECT  12
+#define USBASP_FUNC_TPI_RAWREAD     13
+#define USBASP_FUNC_TPI_RAWWRITE    14
+#define USBASP_FUNC_TPI_READBLOCK   15
+#define USBASP_FUNC_TPI_WRITEBLOCK  16
+#define USBASP_FUNC_GETCAPABILITIES 127
+
+#define USBASP_CAP_0_TPI        0x01
 
 #define PROG_BLOCKFLAG_FIRST    1
 #define PROG_BLOCKFLAG_LAST     2
@@ -67,6 +91,52 @@
 
 /* additional functions */
 #define FUNC_ECHO               0x17
+#define FUNC_READ_TIMING        0x18
+#define FUNC_STUB_LOAD          0x19
+#define FUNC_STUB_START         0x1a
+#define FUNC_STUB_FINISH        0x1b
+#define FUNC_STUB_CRC           0x1c
+#define FUNC_GANG_SETUP         0x1d
+#define FUNC_GANG_STATUS        0x1e
+#define FUNC_SELECT_TARGET      0x1f
+#define FUNC_STORAGE_ERASE      0x20
+#define FUNC_STORAGE_WRITE      0x21
+#define FUNC_STORAGE_READ       0x22
+#define FUNC_STANDALONE_RUN     0x23
+#define FUNC_STANDALONE_RESULT  0x24
+#define FUNC_PATCH_SET          0x25
+#define FUNC_PATCH_COUNTER      0x26
+#define FUNC_PATCH_SET_COUNTER  0x27
+#define FUNC_UPDI_CONNECT       0x28
+#define FUNC_UPDI_DISCONNECT    0x29
+#define FUNC_UPDI_SEND          0x2a
+#define FUNC_UPDI_RECV          0x2b
+#define FUNC_UPDI_READ          0x2c
+#define FUNC_UPDI_WRITE         0x2d
+#define FUNC_SET_FAMILY         0x2e
+#define FUNC_SPIFLASH_CONNECT   0x2f
+#define FUNC_SPIFLASH_DISCONNECT 0x30
+#define FUNC_SPIFLASH_READ      0x31
+#define FUNC_SPIFLASH_WRITE     0x32
+#define FUNC_SPIFLASH_ERASE     0x33
+#define FUNC_SPIFLASH_STATUS    0x34
+#define FUNC_UART_CONFIG        0x35
+#define FUNC_UART_READ          0x36
+#define FUNC_UART_WRITE         0x37
+#define FUNC_UART_STATUS        0x38
+#define FUNC_SET_CLOCK          0x39
+#define FUNC_PROFILE_READ       0x3a
+#define FUNC_PROFILE_RESET      0x3b
+#define FUNC_POLL_STATS         0x3c
+#define FUNC_POLL_RESET         0x3d
+#define FUNC_TRACE_READ         0x3e
+#define FUNC_TELEMETRY          0x3f
+#define FUNC_SAMPLER_START      0x40
+#define FUNC_SAMPLER_READ       0x41
+#define FUNC_MEMORY             0x42
+#define FUNC_STUB_STATUS        0x43
+#define FUNC_STORAGE_STATUS     0x44
+#define FUNC_PATCH_ENABLE       0x45
 
 /* supply custom usbDeviceConnect() and usbDeviceDisconnect() macros
  * which turn the interrupt on and off at the right times,
@@ -97,6 +167,22 @@ enum mode_t {
     WRITE_FLASH,
     READ_EEPROM,
     WRITE_EEPROM,
+    WRITE_FLASH_STUB,
+    WRITE_STORAGE,
+    READ_STORAGE,
+    READ_TPI,
+    WRITE_TPI,
+    SEND_UPDI,
+    RECV_UPDI,
+    READ_UPDI,
+    WRITE_UPDI,
+    READ_SPIFLASH,
+    WRITE_SPIFLASH,
+    READ_UART,
+    WRITE_UART,
+    READ_TRACE,
+    READ_TELEMETRY,
+    READ_TELEMETRY_LIFETIME,
 };
 
 struct options_t {
@@ -112,10 +198,22 @@ struct options_t {
 
 struct options_t opts;
 
+#ifdef ENABLE_STANDALONE
+static bool storage_ok;
+#endif
+
+#ifdef ENABLE_UPDI
+static bool updi_ok;
+#endif
+
+#ifdef ENABLE_SPIFLASH
+static bool spiflash_ok;
+#endif
+
 /* usb serial number, will be setup by usb_init() */
 int usbDescriptorStringSerialNumber[CONFIG_USB_SERIAL_LEN+1];
 
-usbMsgLen_t usbFunctionSetup(uchar data[8])
+static usbMsgLen_t usb_setup(uchar data[8])
 {
     usbRequest_t *req = (void *)data;
     uint8_t len = 0;
@@ -124,8 +222,15 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
     /* set global data pointer to local buffer */
     usbMsgPtr = buf;
 
+#ifdef ENABLE_STANDALONE
+    /* usb is polled during a standalone run, only its result is available */
+    if (standalone_result() == STANDALONE_BUSY
+            && req->bRequest != FUNC_STANDALONE_RESULT)
+        return 0;
+#endif
+
     if (req->bRequest == USBASP_FUNC_CONNECT) {
-        debug_putc('E');
+        debug_event(DEBUG_CONNECT, 0);
 
         /* reset options */
         opts.address = 0;
@@ -135,10 +240,22 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
         spi_enable();
         LED1_ON();
     } else if (req->bRequest == USBASP_FUNC_DISCONNECT) {
-        debug_putc('e');
+        debug_event(DEBUG_DISCONNECT, 0);
+        isp_finish();
+#ifdef ENABLE_PATCH
+        /* the next unit gets the next counter value if the patched bytes
+         * have been written to this one */
+        if (patch_verify())
+            patch_next();
+        patch_enable(false);
+#endif
+#ifdef ENABLE_TELEMETRY_LIFETIME
+        telemetry_save();
+#endif
         spi_disable();
         LED1_OFF();
     } else if (req->bRequest == USBASP_FUNC_TRANSMIT) {
+        isp_finish();
         buf[0] = spi_send(data[2]);
         buf[1] = spi_send(data[3]);
         buf[2] = spi_send(data[4]);
@@ -153,17 +270,17 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
         opts.bytecount = req->wLength.word;
         opts.mode = READ_FLASH;
 
-        debug_putc('R');
+        debug_event(DEBUG_READ, req->bRequest);
 
         /* call usbFunctionRead() */
         return USB_NO_MSG;
     } else if (req->bRequest == USBASP_FUNC_ENABLEPROG) {
-        debug_putc('p');
+        debug_event(DEBUG_ENABLEPROG, 0);
         buf[0] = !isp_attach(opts.freq);
         len = 1;
     } else if (req->bRequest == USBASP_FUNC_WRITEFLASH) {
 
-        debug_putc('W');
+        debug_event(DEBUG_WRITE, req->bRequest);
 
         /* load old address, if requested */
         if (!opts.address_mode == 0)
@@ -179,6 +296,11 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
         opts.bytecount = req->wLength.word;
         opts.mode = WRITE_FLASH;
 
+#ifdef ENABLE_LOADER_STUB
+        if (stub_running())
+            opts.mode = WRITE_FLASH_STUB;
+#endif
+
         return USB_NO_MSG;
     } else if (req->bRequest == USBASP_FUNC_READEEPROM) {
 
@@ -189,7 +311,7 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
         opts.bytecount = req->wLength.word;
         opts.mode = READ_EEPROM;
 
-        debug_putc('R');
+        debug_event(DEBUG_READ, req->bRequest);
 
         /* call usbFunctionRead() */
         return USB_NO_MSG;
@@ -202,7 +324,7 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
         opts.bytecount = req->wLength.word;
         opts.mode = WRITE_EEPROM;
 
-        debug_putc('W');
+        debug_event(DEBUG_WRITE, req->bRequest);
 
         /* call usbFunctionWrite() */
         return USB_NO_MSG;
@@ -213,6 +335,312 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
         opts.freq = data[2];
         buf[0] = 0;
         len = 1;
+#ifdef ENABLE_TPI
+    } else if (req->bRequest == USBASP_FUNC_TPI_CONNECT) {
+        /* wValue is the half bit time */
+        tpi_connect(req->wValue.word);
+        LED1_ON();
+    } else if (req->bRequest == USBASP_FUNC_TPI_DISCONNECT) {
+        tpi_disconnect();
+        LED1_OFF();
+    } else if (req->bRequest == USBASP_FUNC_TPI_RAWREAD) {
+        buf[0] = tpi_recv();
+        len = 1;
+    } else if (req->bRequest == USBASP_FUNC_TPI_RAWWRITE) {
+        tpi_send(req->wValue.bytes[0]);
+    } else if (req->bRequest == USBASP_FUNC_TPI_READBLOCK) {
+        opts.address = req->wValue.word;
+        opts.bytecount = req->wLength.word;
+        opts.mode = READ_TPI;
+
+        return USB_NO_MSG;
+    } else if (req->bRequest == USBASP_FUNC_TPI_WRITEBLOCK) {
+        opts.address = req->wValue.word;
+        opts.bytecount = req->wLength.word;
+        opts.mode = WRITE_TPI;
+
+        return USB_NO_MSG;
+#endif
+#if defined(ENABLE_AT89) || defined(ENABLE_I2C)
+    } else if (req->bRequest == FUNC_SET_FAMILY) {
+        /* wValue is the family (ISP_FAMILY_*), wIndex the page size and
+         * more parameters, see isp_set_family() */
+        buf[0] = !isp_set_family(req->wValue.bytes[0], req->wIndex.word);
+        len = 1;
+#endif
+#ifdef ENABLE_SPIFLASH
+    } else if (req->bRequest == FUNC_SPIFLASH_CONNECT) {
+        /* returns the jedec id */
+        spiflash_connect(buf);
+        len = 3;
+        LED1_ON();
+    } else if (req->bRequest == FUNC_SPIFLASH_DISCONNECT) {
+        spiflash_disconnect();
+        LED1_OFF();
+    } else if (req->bRequest == FUNC_SPIFLASH_READ || req->bRequest == FUNC_SPIFLASH_WRITE) {
+        /* the address is wValue | wIndex << 16 */
+        uint32_t address = req->wValue.word | (uint32_t)req->wIndex.bytes[0] << 16;
+        if (req->bRequest == FUNC_SPIFLASH_READ) {
+            spiflash_ok = spiflash_read_start(address);
+            opts.mode = READ_SPIFLASH;
+        } else {
+            spiflash_write_start(address);
+            spiflash_ok = true;
+            opts.mode = WRITE_SPIFLASH;
+        }
+        opts.bytecount = req->wLength.word;
+
+        return USB_NO_MSG;
+    } else if (req->bRequest == FUNC_SPIFLASH_ERASE) {
+        /* the address is wValue | wIndex.lo << 16, wIndex.hi the type,
+         * returns 1 if the flash is busy, poll FUNC_SPIFLASH_STATUS until
+         * WIP (bit 0) is clear before the next read or write */
+        buf[0] = !spiflash_erase(req->wIndex.bytes[1],
+                req->wValue.word | (uint32_t)req->wIndex.bytes[0] << 16);
+        len = 1;
+    } else if (req->bRequest == FUNC_SPIFLASH_STATUS) {
+        buf[0] = spiflash_status();
+        len = 1;
+#endif
+#ifdef ENABLE_UART_BRIDGE
+    } else if (req->bRequest == FUNC_UART_CONFIG) {
+        /* the baudrate is wValue | wIndex << 16, 0 disables the bridge,
+         * returns the baudrate actually used */
+        uint32_t baud = uart_config(req->wValue.word | (uint32_t)req->wIndex.word << 16);
+        for (uint8_t i = 0; i < 4; i++) {
+            buf[i] = baud;
+            baud >>= 8;
+        }
+        len = 4;
+    } else if (req->bRequest == FUNC_UART_READ) {
+        /* returns up to wLength received bytes */
+        opts.bytecount = uart_rx_available();
+        if (opts.bytecount > req->wLength.word)
+            opts.bytecount = req->wLength.word;
+        opts.mode = READ_UART;
+
+        return USB_NO_MSG;
+    } else if (req->bRequest == FUNC_UART_WRITE) {
+        /* check the free space with FUNC_UART_STATUS first */
+        opts.bytecount = req->wLength.word;
+        opts.mode = WRITE_UART;
+
+        return USB_NO_MSG;
+    } else if (req->bRequest == FUNC_UART_STATUS) {
+        buf[0] = uart_rx_available();
+        buf[1] = uart_tx_free();
+        buf[2] = uart_errors();
+        len = 3;
+#endif
+#ifdef ENABLE_CLOCK_OUTPUT
+    } else if (req->bRequest == FUNC_SET_CLOCK) {
+        /* the frequency in Hz is wValue | wIndex << 16, returns the frequency
+         * actually generated (little endian) */
+        uint32_t freq = clock_output(req->wValue.word | (uint32_t)req->wIndex.word << 16);
+        for (uint8_t i = 0; i < 4; i++) {
+            buf[i] = freq;
+            freq >>= 8;
+        }
+        len = 4;
+#endif
+#ifdef ENABLE_PROFILE
+    } else if (req->bRequest == FUNC_PROFILE_READ) {
+        /* struct profile_t for each section from byte wValue on, at most
+         * 250 bytes per request, the entry of this request is updated
+         * while it is sent */
+        uint16_t offset = req->wValue.word;
+        if (offset > sizeof(profile))
+            offset = sizeof(profile);
+        usbMsgPtr = (uchar *)profile + offset;
+
+        uint16_t remaining = sizeof(profile) - offset;
+        return remaining < 250 ? remaining : 250;
+    } else if (req->bRequest == FUNC_PROFILE_RESET) {
+        profile_reset();
+#endif
+#ifdef ENABLE_POLL_STATS
+    } else if (req->bRequest == FUNC_POLL_STATS) {
+        usbMsgPtr = (uchar *)&poll_stats;
+        return sizeof(poll_stats);
+    } else if (req->bRequest == FUNC_POLL_RESET) {
+        poll_stats_reset();
+#endif
+#if defined(DEBUG) && !defined(DEBUG_UART)
+    } else if (req->bRequest == FUNC_TRACE_READ) {
+        /* returns up to wLength bytes of buffered events (see debug.h) */
+        opts.bytecount = req->wLength.word;
+        opts.mode = READ_TRACE;
+
+        return USB_NO_MSG;
+#endif
+#ifdef ENABLE_TELEMETRY
+    } else if (req->bRequest == FUNC_TELEMETRY) {
+        /* the record described in telemetry.h, with the counters since
+         * power-up if wValue is 0, the lifetime counters otherwise */
+        opts.address = 0;
+        opts.bytecount = TELEMETRY_RECORD;
+        opts.mode = req->wValue.word ? READ_TELEMETRY_LIFETIME : READ_TELEMETRY;
+
+        return USB_NO_MSG;
+#endif
+#ifdef ENABLE_SAMPLER
+    } else if (req->bRequest == FUNC_SAMPLER_START) {
+        /* wValue is the rate (low byte, 0 stops) and the shift, wIndex the
+         * base address of the histogram (see sampler.h) */
+        sampler_start(req->wValue.bytes[0], req->wValue.bytes[1], req->wIndex.word);
+    } else if (req->bRequest == FUNC_SAMPLER_READ) {
+        usbMsgPtr = (uchar *)&sampler;
+        return sizeof(sampler);
+#endif
+#ifdef ENABLE_MEMORY_STATS
+    } else if (req->bRequest == FUNC_MEMORY) {
+        static struct memory_t memory;
+
+        memory_read(&memory);
+        usbMsgPtr = (uchar *)&memory;
+        return sizeof(memory);
+#endif
+    } else if (req->bRequest == USBASP_FUNC_GETCAPABILITIES) {
+        buf[0] = 0;
+#ifdef ENABLE_TPI
+        buf[0] |= USBASP_CAP_0_TPI;
+#endif
+        buf[1] = 0;
+        buf[2] = 0;
+        buf[3] = 0;
+        len = 4;
+    } else if (req->bRequest == FUNC_READ_TIMING) {
+        /* learned write cycle times in timer steps (64us at 16MHz) */
+        buf[0] = isp_timing.flash_page;
+        buf[1] = isp_timing.flash_page_samples;
+        buf[2] = isp_timing.eeprom;
+        buf[3] = isp_timing.eeprom_samples;
+        len = 4;
+#ifdef ENABLE_LOADER_STUB
+    } else if (req->bRequest == FUNC_STUB_LOAD) {
+        /* wValue is the boot section address, wIndex the stub image, loading
+         * is completed by polling FUNC_STUB_STATUS like the requests below */
+        uint16_t pagesize = stub_load(req->wIndex.bytes[0], req->wValue.word);
+        buf[0] = (pagesize == 0);
+        buf[1] = LO8(pagesize);
+        buf[2] = HI8(pagesize);
+        len = 3;
+    } else if (req->bRequest == FUNC_STUB_START) {
+        buf[0] = !stub_start(req->wValue.bytes[0]);
+        len = 1;
+    } else if (req->bRequest == FUNC_STUB_FINISH) {
+        buf[0] = !stub_finish(opts.freq);
+        len = 1;
+    } else if (req->bRequest == FUNC_STUB_CRC) {
+        /* wValue is the end address */
+        buf[0] = !stub_crc(req->wValue.word);
+        len = 1;
+    } else if (req->bRequest == FUNC_STUB_STATUS) {
+        /* STUB_BUSY, STUB_DONE or STUB_FAILED and the checksum (little endian) */
+        uint16_t crc;
+        buf[0] = stub_status(&crc);
+        buf[1] = LO8(crc);
+        buf[2] = HI8(crc);
+        len = 3;
+#endif
+#ifdef ENABLE_GANG
+    } else if (req->bRequest == FUNC_GANG_SETUP) {
+        /* wValue selects the devices, 0 disables gang mode */
+        gang.mask = req->wValue.bytes[0] & GANG_MASK;
+        buf[0] = gang.mask;
+        len = 1;
+    } else if (req->bRequest == FUNC_GANG_STATUS) {
+        buf[0] = gang.mask;
+        buf[1] = gang.attached;
+        buf[2] = gang.busy;
+        buf[3] = gang.failed;
+        len = 4;
+#endif
+#ifdef ENABLE_MULTI_TARGET
+    } else if (req->bRequest == FUNC_SELECT_TARGET) {
+        buf[0] = !spi_select(req->wValue.bytes[0]);
+        len = 1;
+#endif
+#ifdef ENABLE_STANDALONE
+    } else if (req->bRequest == FUNC_STORAGE_ERASE) {
+        /* the storage address is wValue | wIndex << 16 for these requests,
+         * erasing takes up to a few 100ms, poll FUNC_STORAGE_STATUS */
+        buf[0] = !storage_erase(req->wValue.word | (uint32_t)req->wIndex.word << 16);
+        len = 1;
+    } else if (req->bRequest == FUNC_STORAGE_STATUS) {
+        /* 0xff if no storage is fitted */
+        buf[0] = storage_status();
+        len = 1;
+    } else if (req->bRequest == FUNC_STORAGE_WRITE) {
+        storage_ok = storage_write_start(req->wValue.word | (uint32_t)req->wIndex.word << 16);
+        opts.bytecount = req->wLength.word;
+        opts.mode = WRITE_STORAGE;
+
+        return USB_NO_MSG;
+    } else if (req->bRequest == FUNC_STORAGE_READ) {
+        storage_ok = storage_read_start(req->wValue.word | (uint32_t)req->wIndex.word << 16);
+        opts.bytecount = req->wLength.word;
+        opts.mode = READ_STORAGE;
+
+        return USB_NO_MSG;
+    } else if (req->bRequest == FUNC_STANDALONE_RUN) {
+        /* the run starts from the main loop, poll FUNC_STANDALONE_RESULT */
+        standalone_start();
+        buf[0] = 0;
+        len = 1;
+    } else if (req->bRequest == FUNC_STANDALONE_RESULT) {
+        buf[0] = standalone_result();
+        len = 1;
+#endif
+#ifdef ENABLE_PATCH
+    } else if (req->bRequest == FUNC_PATCH_SET) {
+        /* wValue is the address, wIndex the length (low byte) and the entry
+         * (bits 0-3) and flags (bits 4-7, see patch.h) in the high byte */
+        patch_set(req->wIndex.bytes[1] & 0x0f, req->wValue.word,
+                req->wIndex.bytes[0], req->wIndex.bytes[1] >> 4);
+        buf[0] = 0;
+        len = 1;
+    } else if (req->bRequest == FUNC_PATCH_ENABLE) {
+        /* wValue 1 patches the writes up to the next disconnect */
+        patch_enable(req->wValue.bytes[0]);
+        buf[0] = 0;
+        len = 1;
+    } else if (req->bRequest == FUNC_PATCH_COUNTER) {
+        uint32_t counter = patch_counter();
+        for (uint8_t i = 0; i < 4; i++) {
+            buf[i] = counter;
+            counter >>= 8;
+        }
+        len = 4;
+    } else if (req->bRequest == FUNC_PATCH_SET_COUNTER) {
+        patch_set_counter(req->wValue.word | (uint32_t)req->wIndex.word << 16);
+        buf[0] = 0;
+        len = 1;
+#endif
+#ifdef ENABLE_UPDI
+    } else if (req->bRequest == FUNC_UPDI_CONNECT) {
+        /* returns STATUSA, 0 if the device does not respond */
+        buf[0] = updi_connect();
+        len = 1;
+        LED1_ON();
+    } else if (req->bRequest == FUNC_UPDI_DISCONNECT) {
+        updi_disconnect();
+        LED1_OFF();
+    } else if (req->bRequest == FUNC_UPDI_SEND || req->bRequest == FUNC_UPDI_RECV) {
+        /* raw instructions, e.g. keys, control registers and sib */
+        updi_ok = true;
+        opts.bytecount = req->wLength.word;
+        opts.mode = (req->bRequest == FUNC_UPDI_SEND) ? SEND_UPDI : RECV_UPDI;
+
+        return USB_NO_MSG;
+    } else if (req->bRequest == FUNC_UPDI_READ || req->bRequest == FUNC_UPDI_WRITE) {
+        /* wValue is the data space address */
+        updi_ok = updi_pointer(req->wValue.word);
+        opts.bytecount = req->wLength.word;
+        opts.mode = (req->bRequest == FUNC_UPDI_READ) ? READ_UPDI : WRITE_UPDI;
+
+        return USB_NO_MSG;
+#endif
 #ifdef ENABLE_ECHO_FUNC
     } else if (req->bRequest == FUNC_ECHO) {
         buf[0] = req->wValue.bytes[0];
@@ -224,14 +652,103 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
     return len;
 }
 
-uchar usbFunctionWrite(uchar *data, uchar len)
+static uchar usb_write(uchar *data, uchar len)
 {
     uint8_t ret = 0;
 
     if (opts.bytecount < len)
         len = opts.bytecount;
 
+#ifdef ENABLE_STANDALONE
+    /* a standalone run uses isp and storage */
+    if (standalone_result() == STANDALONE_BUSY)
+        return 0xff;
+
+    if (opts.mode == WRITE_STORAGE) {
+        for (uint8_t i = 0; storage_ok && i < len; i++)
+            storage_ok = storage_write(data[i]);
+        opts.bytecount -= len;
+
+        if (opts.bytecount == 0 || !storage_ok)
+            storage_stop();
+
+        /* stall if the storage is busy or missing */
+        if (!storage_ok)
+            return 0xff;
+
+        LED1_TOGGLE();
+        return opts.bytecount == 0;
+    }
+#endif
+
+#ifdef ENABLE_TPI
+    if (opts.mode == WRITE_TPI) {
+        tpi_write_block(opts.address, data, len);
+        opts.address += len;
+        opts.bytecount -= len;
+
+        LED1_TOGGLE();
+        return opts.bytecount == 0;
+    }
+#endif
+
+#ifdef ENABLE_UART_BRIDGE
+    if (opts.mode == WRITE_UART) {
+        for (uint8_t i = 0; i < len; i++)
+            uart_putc(data[i]);
+        opts.bytecount -= len;
+
+        return opts.bytecount == 0;
+    }
+#endif
+
+#ifdef ENABLE_SPIFLASH
+    if (opts.mode == WRITE_SPIFLASH) {
+        for (uint8_t i = 0; spiflash_ok && i < len; i++)
+            spiflash_ok = spiflash_write(data[i]);
+        opts.bytecount -= len;
+
+        /* program the last page */
+        if (opts.bytecount == 0 || !spiflash_ok)
+            spiflash_stop();
+
+        /* stall if the flash stays busy */
+        if (!spiflash_ok)
+            return 0xff;
+
+        LED1_TOGGLE();
+        return opts.bytecount == 0;
+    }
+#endif
+
+#ifdef ENABLE_UPDI
+    if (opts.mode == SEND_UPDI || opts.mode == WRITE_UPDI) {
+        if (opts.mode == SEND_UPDI) {
+            for (uint8_t i = 0; updi_ok && i < len; i++)
+                updi_ok = updi_send(data[i]);
+        } else if (updi_ok) {
+            updi_ok = updi_write_block(data, len);
+        }
+        opts.bytecount -= len;
+
+        if (opts.mode == WRITE_UPDI && (opts.bytecount == 0 || !updi_ok))
+            updi_write_end();
+
+        /* stall on errors */
+        if (!updi_ok)
+            return 0xff;
+
+        LED1_TOGGLE();
+        return opts.bytecount == 0;
+    }
+#endif
+
     for (uint8_t i = 0; i < len; i++) {
+#ifdef ENABLE_PATCH
+        *data = patch_apply(opts.mode == WRITE_EEPROM ? PATCH_EEPROM : 0,
+                opts.address, *data);
+#endif
+
         if (opts.mode == WRITE_FLASH) {
             if (opts.pagesize == 0)
                 isp_write_flash_page(opts.address, *data, 1);
@@ -239,12 +756,19 @@ uchar usbFunctionWrite(uchar *data, uchar len)
                 isp_write_flash_page(opts.address, *data, 0);
                 opts.pagecounter--;
 
-                /* if a whole flash page is filled, save */
+                /* if a whole flash page is filled, save, the write cycle
+                 * is waited for by the next isp call */
                 if (opts.pagecounter == 0) {
-                    isp_save_flash_page(opts.address);
+                    isp_start_flash_page(opts.address);
                     opts.pagecounter = opts.pagesize;
                 }
             }
+#ifdef ENABLE_LOADER_STUB
+        } else if (opts.mode == WRITE_FLASH_STUB) {
+            /* stall if the stub does not take the page */
+            if (!stub_write(opts.address, *data))
+                return 0xff;
+#endif
         } else
             isp_write_eeprom(opts.address, *data);
 
@@ -253,9 +777,19 @@ uchar usbFunctionWrite(uchar *data, uchar len)
         if (opts.bytecount == 0) {
             /* if this is the last block, and an incomplete page has not yet been
              * written, do it now */
+#ifdef ENABLE_LOADER_STUB
+            if (opts.mode == WRITE_FLASH_STUB) {
+                if (opts.blockflags & PROG_BLOCKFLAG_LAST)
+                    stub_flush();
+            } else
+#endif
+            /* complete a pending i2c page write */
+            if (opts.mode == WRITE_EEPROM) {
+                isp_finish();
+            } else
             if (opts.blockflags & PROG_BLOCKFLAG_LAST
                     && opts.pagecounter != opts.pagesize) {
-                isp_save_flash_page(opts.address);
+                isp_start_flash_page(opts.address);
             }
 
             ret = 1;
@@ -265,31 +799,177 @@ uchar usbFunctionWrite(uchar *data, uchar len)
         data++;
     }
 
+#ifdef ENABLE_I2C
+    /* stall if the i2c eeprom does not acknowledge */
+    if (!i2c_ok())
+        return 0xff;
+#endif
+
     LED1_TOGGLE();
 
     return ret;
 }
 
-uchar usbFunctionRead(uchar *data, uchar len)
+static uchar usb_read(uchar *data, uchar len)
 {
     if (opts.bytecount < len)
         len = opts.bytecount;
 
+#ifdef ENABLE_STANDALONE
+    if (standalone_result() == STANDALONE_BUSY)
+        return 0;
+
+    if (opts.mode == READ_STORAGE) {
+        /* a short packet ends the transfer if the storage is busy or missing */
+        if (!storage_ok)
+            return 0;
+
+        for (uint8_t i = 0; i < len; i++)
+            data[i] = storage_read();
+
+        opts.bytecount -= len;
+        if (opts.bytecount == 0)
+            storage_stop();
+
+        return len;
+    }
+#endif
+
+#ifdef ENABLE_TPI
+    if (opts.mode == READ_TPI) {
+        tpi_read_block(opts.address, data, len);
+        opts.address += len;
+        opts.bytecount -= len;
+
+        LED1_TOGGLE();
+        return len;
+    }
+#endif
+
+#ifdef ENABLE_TELEMETRY
+    if (opts.mode == READ_TELEMETRY || opts.mode == READ_TELEMETRY_LIFETIME) {
+        for (uint8_t i = 0; i < len; i++)
+            data[i] = telemetry_read(opts.address++, opts.mode == READ_TELEMETRY_LIFETIME);
+        opts.bytecount -= len;
+
+        return len;
+    }
+#endif
+
+#if defined(DEBUG) && !defined(DEBUG_UART)
+    if (opts.mode == READ_TRACE) {
+        /* a short packet ends the transfer when the buffer is empty */
+        len = debug_read(data, len);
+        opts.bytecount -= len;
+
+        return len;
+    }
+#endif
+
+#ifdef ENABLE_UART_BRIDGE
+    if (opts.mode == READ_UART) {
+        for (uint8_t i = 0; i < len; i++)
+            data[i] = uart_getc();
+        opts.bytecount -= len;
+
+        return len;
+    }
+#endif
+
+#ifdef ENABLE_SPIFLASH
+    if (opts.mode == READ_SPIFLASH) {
+        /* a short packet ends the transfer if the flash is busy */
+        if (!spiflash_ok)
+            return 0;
+
+        for (uint8_t i = 0; i < len; i++)
+            data[i] = spiflash_read();
+        opts.bytecount -= len;
+
+        if (opts.bytecount == 0)
+            spiflash_stop();
+
+        LED1_TOGGLE();
+        return len;
+    }
+#endif
+
+#ifdef ENABLE_UPDI
+    if (opts.mode == RECV_UPDI || opts.mode == READ_UPDI) {
+        if (opts.mode == RECV_UPDI) {
+            for (uint8_t i = 0; updi_ok && i < len; i++)
+                updi_ok = updi_recv(&data[i]);
+        } else if (updi_ok) {
+            updi_ok = updi_read_block(data, len);
+        }
+        opts.bytecount -= len;
+
+        /* a short packet ends the transfer on errors */
+        if (!updi_ok)
+            return 0;
+
+        LED1_TOGGLE();
+        return len;
+    }
+#endif
+
     for (uint8_t i = 0; i < len; i++) {
         if (opts.mode == READ_FLASH) {
-            *data++ = isp_read_flash(opts.address++);
+            *data = isp_read_flash(opts.address++);
         } else {
-            *data++ = isp_read_eeprom(opts.address++);
+            *data = isp_read_eeprom(opts.address++);
         }
+#ifdef ENABLE_GANG
+        isp_gang_verify(*data);
+#endif
+        data++;
     }
 
     opts.bytecount -= len;
 
+#ifdef ENABLE_I2C
+    /* a short packet ends the transfer if the i2c eeprom does not acknowledge */
+    if (!i2c_ok())
+        return 0;
+#endif
+
     LED1_TOGGLE();
 
     return len;
 }
 
+/* v-usb callbacks, the handlers above are wrapped for the profiler */
+usbMsgLen_t usbFunctionSetup(uchar data[8])
+{
+#ifdef ENABLE_POLL_STATS
+    poll_stats_request = data[1];
+#endif
+
+    PROFILE_START(start);
+    usbMsgLen_t len = usb_setup(data);
+    PROFILE_STOP_REQUEST(data[1], start);
+
+    return len;
+}
+
+uchar usbFunctionWrite(uchar *data, uchar len)
+{
+    PROFILE_START(start);
+    uchar ret = usb_write(data, len);
+    PROFILE_STOP(PROFILE_USB_WRITE, start);
+
+    return ret;
+}
+
+uchar usbFunctionRead(uchar *data, uchar len)
+{
+    PROFILE_START(start);
+    len = usb_read(data, len);
+    PROFILE_STOP(PROFILE_USB_READ, start);
+
+    return len;
+}
+
 void usb_init(void)
 {
     /* init usb serial header */
@@ -341,6 +1021,9 @@ void usb_init(void)
 
 void usb_poll(void)
 {
+#ifdef ENABLE_POLL_STATS
+    poll_stats_update();
+#endif
     usbPoll();
 }
 
@@ -354,3 +1037,14 @@ void usb_enable(void)
     usbDeviceConnect();
     opts.freq = USBASP_ISP_SCK_AUTO;
 }
+
+void usb_reconnect(void)
+{
+    usb_disable();
+
+    /* 0 means 0x10000 iterations of 4 cycles */
+    for (uint8_t i = 0; i < USB_DISCONNECT_LOOPS; i++)
+        _delay_loop_2(0);
+
+    usb_enable();
+}
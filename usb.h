@@ -28,6 +28,8 @@
 
 #include <stdint.h>
 #include <avr/eeprom.h>
+#include "patch.h"
+#include "telemetry.h"
 
 /* api functions */
 
@@ -40,11 +42,21 @@ void usb_poll(void);
 
 void usb_disable(void);
 void usb_enable(void);
+/* disconnect for USB_DISCONNECT_MS, so that the host re-enumerates this
+ * device, works without the timer */
+void usb_reconnect(void);
 
 /* usb serial number is stored in eeprom */
 struct eeprom_storage_t {
     uint8_t serial[CONFIG_USB_SERIAL_LEN];
     uint16_t crc;
+#ifdef ENABLE_PATCH
+    struct patch_t patches[PATCH_ENTRIES];
+    uint32_t patch_counter;
+#endif
+#ifdef ENABLE_TELEMETRY_LIFETIME
+    uint32_t telemetry[TELEMETRY_COUNTERS];
+#endif
 };
 
 extern EEMEM struct eeprom_storage_t eeprom_storage;
@@ -657,7 +657,11 @@ extern usbTxStatus_t   usbTxStatus1, usbTxStatus3;
 
 
 typedef union usbWord{
+#if defined(__SIZEOF_INT__) && __SIZEOF_INT__ > 2  /* e.g. native test builds */
+    unsigned short  word;
+#else
     unsigned    word;
+#endif
     uchar       bytes[2];
 }usbWord_t;
 